@@ -6,11 +6,51 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
 
 #include <sysconfig.h>
 #include <ifile.h>
 #include <ulppk-properties.h>
 
+#include "democonfig.h"
+
+#define DEMOCONFIG_MAX_SETTINGS 128
+#define DEMOCONFIG_NAME_LEN 64
+#define DEMOCONFIG_VALUE_LEN 256
+
+/*
+ * One "key = value" line from the ini file, with the [section] it was found in.
+ */
+typedef struct {
+	char section[DEMOCONFIG_NAME_LEN];
+	char key[DEMOCONFIG_NAME_LEN];
+	char value[DEMOCONFIG_VALUE_LEN];
+} DEMOCONFIG_SETTING;
+
+static DEMOCONFIG_SETTING settings[DEMOCONFIG_MAX_SETTINGS];
+static int nsettings = 0;
+static char loaded_path[512];
+static struct stat loaded_stat;		// of loaded_path, when it was read
+
+/*
+ * Trim leading and trailing white space in place.
+ */
+static char* democonfig_trim(char* cp) {
+	char* endp;
+
+	while (isspace((unsigned char)*cp)) {
+		cp++;
+	}
+	endp = cp + strlen(cp);
+	while ((endp > cp) && isspace((unsigned char)endp[-1])) {
+		*--endp = '\0';
+	}
+	return cp;
+}
+
 /*
  * Convenience function for setting up an application.
  * Don't use for daemons ... presumes console
@@ -21,7 +61,135 @@ void app_init(char* appname, int argc, char* argv[]) {
 	// that info, open and parse the ini file.
 	sysconfig_parse_inifile(appname);
 
+	// Load the demo's own tuning settings from the same file
+	democonfig_load(appname);
+
 	log_app_start(argc, argv);
 
 
 }
+
+/*
+ * Load the settings of an application's ini file so they can be
+ * fetched with democonfig_get_int and democonfig_get_string.
+ *
+ * As with sysconfig, the file is $SYSCONFIG_INI_FILE_NAME if that is
+ * set (a file name in the ini directory, as demoserver.env sets it, or an
+ * absolute path), <appname>.ini otherwise. The ini directory is
+ * $SYSCONFIG_ETC, or /usr/local/etc (where make install puts the ini
+ * files) if SYSCONFIG_ETC is not set. A missing file is not an error;
+ * every getter has a default.
+ *
+ * Returns the number of settings loaded, -1 if the file can't be read.
+ */
+int democonfig_load(char* appname) {
+	char path[512];
+	char line[512];
+	char section[DEMOCONFIG_NAME_LEN];
+	char* etcp;
+	char* namep;
+	char* cp;
+	char* valp;
+	FILE* fp;
+	DEMOCONFIG_SETTING* sp;
+
+	etcp = getenv("SYSCONFIG_ETC");
+	if (NULL == etcp) {
+		etcp = "/usr/local/etc";
+	}
+	namep = getenv("SYSCONFIG_INI_FILE_NAME");
+	if ((NULL == namep) || (*namep == '\0')) {
+		snprintf(path, sizeof(path), "%s/%s.ini", etcp, appname);
+	} else if (*namep == '/') {
+		snprintf(path, sizeof(path), "%s", namep);
+	} else {
+		snprintf(path, sizeof(path), "%s/%s", etcp, namep);
+	}
+	fp = fopen(path, "r");
+	if (NULL == fp) {
+		return -1;
+	}
+	strcpy(loaded_path, path);
+	if (fstat(fileno(fp), &loaded_stat)) {
+		memset(&loaded_stat, 0, sizeof(loaded_stat));
+	}
+
+	nsettings = 0;
+	section[0] = '\0';
+	while ((NULL != fgets(line, sizeof(line), fp)) && (nsettings < DEMOCONFIG_MAX_SETTINGS)) {
+		cp = democonfig_trim(line);
+		if ((*cp == '\0') || (*cp == '#') || (*cp == ';')) {
+			continue;
+		}
+		if (*cp == '[') {
+			cp[strcspn(cp, "]")] = '\0';
+			strncpy(section, democonfig_trim(cp + 1), sizeof(section) - 1);
+			section[sizeof(section) - 1] = '\0';
+			continue;
+		}
+		valp = strchr(cp, '=');
+		if (NULL == valp) {
+			continue;
+		}
+		*valp++ = '\0';
+		sp = &settings[nsettings++];
+		strcpy(sp->section, section);
+		strncpy(sp->key, democonfig_trim(cp), sizeof(sp->key) - 1);
+		sp->key[sizeof(sp->key) - 1] = '\0';
+		strncpy(sp->value, democonfig_trim(valp), sizeof(sp->value) - 1);
+		sp->value[sizeof(sp->value) - 1] = '\0';
+	}
+	fclose(fp);
+	return nsettings;
+}
+
+/*
+ * Fetch a string setting. Returns defval if the setting is absent.
+ */
+char* democonfig_get_string(char* section, char* key, char* defval) {
+	int i;
+
+	for (i = 0; i < nsettings; i++) {
+		if ((0 == strcmp(settings[i].section, section)) && (0 == strcmp(settings[i].key, key))) {
+			return settings[i].value;
+		}
+	}
+	return defval;
+}
+
+/*
+ * Fetch an integer setting. Returns defval if the setting is absent
+ * or not a number.
+ */
+int democonfig_get_int(char* section, char* key, int defval) {
+	char* valp;
+	char* endp;
+	long val;
+
+	valp = democonfig_get_string(section, key, NULL);
+	if ((NULL == valp) || (*valp == '\0')) {
+		return defval;
+	}
+	val = strtol(valp, &endp, 0);
+	return (*endp == '\0') ? (int)val : defval;
+}
+
+/*
+ * Check whether the ini file loaded by democonfig_load has been
+ * modified since. Cheap enough (one stat) to call from a main loop.
+ *
+ * The modification time is compared to the nanosecond, and the size and
+ * inode as well, so an edit in the same second as the load (or a file
+ * replaced by one with the same time) is not missed.
+ *
+ * Returns non-zero if the file should be reloaded.
+ */
+int democonfig_changed() {
+	struct stat sb;
+
+	if ((loaded_path[0] == '\0') || stat(loaded_path, &sb)) {
+		return 0;
+	}
+	return (sb.st_mtim.tv_sec != loaded_stat.st_mtim.tv_sec) || (sb.st_mtim.tv_nsec != loaded_stat.st_mtim.tv_nsec) ||
+			(sb.st_size != loaded_stat.st_size) || (sb.st_ino != loaded_stat.st_ino);
+}
@@ -12,7 +12,30 @@
 extern "C" {
 #endif
 
-int app_init(char* appname, int argc, char* argv[]);
+// The demoserver input deque is a lane set (see msglanes.h).
+// Control events (shutdown) ride the high lane so they are not
+// queued behind bulk traffic.
+#define DEMO_SERVER_LANES "demo-server"
+#define DEMO_LANE_BULK 0
+#define DEMO_LANE_CONTROL 1
+#define DEMO_NLANES 2
+#define DEMO_LANE_BURST 64		// control messages served before a bulk message gets a turn
+
+// demoserver publishes every state change to this broadcast
+// ring (see smbcast.h) for other processes to follow.
+#define DEMO_TRANSITION_BCAST "demo-transitions"
+#define DEMO_BCAST_SLOTS 4096
+
+// With [demoserver] archive = 1, demoserver appends every processed
+// event to this archive (see evarchive.h) in the data directory.
+#define DEMO_EVENT_ARCHIVE "demo-events"
+#define DEMO_DATA_DIR "/var/ulppk2-demo/data"
+
+void app_init(char* appname, int argc, char* argv[]);
+int democonfig_load(char* appname);
+char* democonfig_get_string(char* section, char* key, char* defval);
+int democonfig_get_int(char* section, char* key, int defval);
+int democonfig_changed();
 
 #ifdef __cplusplus
 }
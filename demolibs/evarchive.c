@@ -0,0 +1,801 @@
+/*
+ *****************************************************************
+
+<GPL>
+
+Copyright: © 2001-2015 Robert C Garvey
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+ .
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ .
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+X-Comment: On Debian systems, the complete text of the GNU General Public
+ License can be found in `/usr/share/common-licenses/GPL-3'.
+
+</GPL>
+*********************************************************************
+*/
+
+/**
+ * @file evarchive.c
+ *
+ * @brief Append only, block compressed archive of processed events.
+ *
+ * The time and serial number columns are stored as differences from
+ * the previous event and split into byte planes (all low bytes, then
+ * all second bytes, ...), which turns small differences into long runs
+ * of zero bytes. Every column then goes through a small LZ77 coder in
+ * the LZ4 style: a token byte with literal and match length nibbles,
+ * the literals, and a two byte match offset. A column that doesn't get
+ * smaller is stored as is.
+ */
+/*
+ *  Created on: Oct 19, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <ulppk_log.h>
+#include <evarchive.h>
+
+#define EVARCH_LZ_HASH_BITS 12
+#define EVARCH_LZ_MIN_MATCH 4
+#define EVARCH_LZ_MAX_OFFSET 65535
+#define EVARCH_NSEC 1000000000LL
+
+// Bytes per event in each column
+static const size_t evarch_col_width[EVARCH_NCOLS] = {
+	sizeof(int64_t), sizeof(uint64_t), 1, 1, 1
+};
+
+/*
+ * Build the path of one of the archive files.
+ */
+static void evarch_path(char* pathbuff, size_t buffsize, char* dir, char* name, char* ext) {
+	snprintf(pathbuff, buffsize, "%s/%s.%s", dir, name, ext);
+}
+
+/*
+ * pwrite all of a buffer. Returns 0 on success, -1 with errno set.
+ */
+static int evarch_pwrite(int fd, void* buff, size_t len, uint64_t offset) {
+	ssize_t n;
+	char* cp = buff;
+
+	while (len > 0) {
+		n = pwrite(fd, cp, len, offset);
+		if (n < 0) {
+			if (EINTR == errno) {
+				continue;
+			}
+			return -1;
+		}
+		cp += n;
+		len -= n;
+		offset += n;
+	}
+	return 0;
+}
+
+/*
+ * Split n values of width bytes into byte planes, and back.
+ */
+static void evarch_shuffle(const unsigned char* src, unsigned char* dst, size_t n, size_t width) {
+	size_t i;
+	size_t b;
+
+	for (i = 0; i < n; i++) {
+		for (b = 0; b < width; b++) {
+			dst[(b * n) + i] = src[(i * width) + b];
+		}
+	}
+}
+
+static void evarch_unshuffle(const unsigned char* src, unsigned char* dst, size_t n, size_t width) {
+	size_t i;
+	size_t b;
+
+	for (b = 0; b < width; b++) {
+		for (i = 0; i < n; i++) {
+			dst[(i * width) + b] = src[(b * n) + i];
+		}
+	}
+}
+
+static uint32_t evarch_read32(const unsigned char* cp) {
+	uint32_t v;
+
+	memcpy(&v, cp, sizeof(v));
+	return v;
+}
+
+/*
+ * Append a length that didn't fit in its token nibble.
+ */
+static unsigned char* evarch_lz_putlen(unsigned char* op, unsigned char* oend, size_t len) {
+	while (len >= 255) {
+		if (op >= oend) {
+			return NULL;
+		}
+		*op++ = 255;
+		len -= 255;
+	}
+	if (op >= oend) {
+		return NULL;
+	}
+	*op++ = (unsigned char)len;
+	return op;
+}
+
+/*
+ * Emit one sequence: literals, then (if matchlen is non-zero) a match.
+ */
+static unsigned char* evarch_lz_sequence(unsigned char* op, unsigned char* oend,
+		const unsigned char* lit, size_t litlen, size_t offset, size_t matchlen) {
+	unsigned char* tokenp = op;
+	size_t mlcode = (matchlen > 0) ? (matchlen - EVARCH_LZ_MIN_MATCH) : 0;
+
+	if (op >= oend) {
+		return NULL;
+	}
+	op++;
+	*tokenp = (unsigned char)(((litlen < 15) ? litlen : 15) << 4);
+	if ((litlen >= 15) && (NULL == (op = evarch_lz_putlen(op, oend, litlen - 15)))) {
+		return NULL;
+	}
+	if ((size_t)(oend - op) < litlen) {
+		return NULL;
+	}
+	memcpy(op, lit, litlen);
+	op += litlen;
+	if (0 == matchlen) {
+		return op;
+	}
+	if ((oend - op) < 2) {
+		return NULL;
+	}
+	*op++ = (unsigned char)(offset & 0xff);
+	*op++ = (unsigned char)(offset >> 8);
+	*tokenp |= (unsigned char)((mlcode < 15) ? mlcode : 15);
+	if ((mlcode >= 15) && (NULL == (op = evarch_lz_putlen(op, oend, mlcode - 15)))) {
+		return NULL;
+	}
+	return op;
+}
+
+/**
+ * @brief Compress a buffer.
+ *
+ * @param src Data to compress.
+ * @param srclen Bytes of data.
+ * @param dst Output buffer.
+ * @param dstcap Size of the output buffer.
+ * @return Compressed size, 0 if it doesn't fit in dstcap.
+ */
+size_t evarch_lz_compress(const unsigned char* src, size_t srclen, unsigned char* dst, size_t dstcap) {
+	uint32_t table[1 << EVARCH_LZ_HASH_BITS];
+	unsigned char* op = dst;
+	unsigned char* oend = dst + dstcap;
+	size_t ip = 0;
+	size_t anchor = 0;
+	size_t ref;
+	size_t len;
+	uint32_t v;
+	uint32_t h;
+
+	memset(table, 0xff, sizeof(table));
+	while ((srclen >= EVARCH_LZ_MIN_MATCH) && (ip <= srclen - EVARCH_LZ_MIN_MATCH)) {
+		v = evarch_read32(src + ip);
+		h = (v * 2654435761U) >> (32 - EVARCH_LZ_HASH_BITS);
+		ref = table[h];
+		table[h] = (uint32_t)ip;
+		if ((ref < ip) && ((ip - ref) <= EVARCH_LZ_MAX_OFFSET) && (evarch_read32(src + ref) == v)) {
+			len = EVARCH_LZ_MIN_MATCH;
+			while (((ip + len) < srclen) && (src[ref + len] == src[ip + len])) {
+				len++;
+			}
+			op = evarch_lz_sequence(op, oend, src + anchor, ip - anchor, ip - ref, len);
+			if (NULL == op) {
+				return 0;
+			}
+			ip += len;
+			anchor = ip;
+		} else {
+			ip++;
+		}
+	}
+	op = evarch_lz_sequence(op, oend, src + anchor, srclen - anchor, 0, 0);
+	return (NULL == op) ? 0 : (size_t)(op - dst);
+}
+
+/*
+ * Read a length continued past its token nibble.
+ */
+static const unsigned char* evarch_lz_getlen(const unsigned char* ip, const unsigned char* iend, size_t* lenp) {
+	unsigned char b;
+
+	do {
+		if (ip >= iend) {
+			return NULL;
+		}
+		b = *ip++;
+		*lenp += b;
+	} while (255 == b);
+	return ip;
+}
+
+/**
+ * @brief Inflate a buffer made by evarch_lz_compress.
+ *
+ * @param src Compressed data.
+ * @param srclen Bytes of compressed data.
+ * @param dst Output buffer.
+ * @param dstlen Size of the output buffer.
+ * @return Inflated size, -1 if the data is corrupt or doesn't fit.
+ */
+ssize_t evarch_lz_decompress(const unsigned char* src, size_t srclen, unsigned char* dst, size_t dstlen) {
+	const unsigned char* ip = src;
+	const unsigned char* iend = src + srclen;
+	unsigned char* op = dst;
+	unsigned char* oend = dst + dstlen;
+	unsigned char* matchp;
+	size_t litlen;
+	size_t matchlen;
+	size_t offset;
+	unsigned char token;
+
+	while (ip < iend) {
+		token = *ip++;
+		litlen = token >> 4;
+		if ((15 == litlen) && (NULL == (ip = evarch_lz_getlen(ip, iend, &litlen)))) {
+			return -1;
+		}
+		if (((size_t)(iend - ip) < litlen) || ((size_t)(oend - op) < litlen)) {
+			return -1;
+		}
+		memcpy(op, ip, litlen);
+		ip += litlen;
+		op += litlen;
+		if (ip == iend) {
+			break;		// last sequence has no match
+		}
+
+		if ((iend - ip) < 2) {
+			return -1;
+		}
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		matchlen = token & 0x0f;
+		if ((15 == matchlen) && (NULL == (ip = evarch_lz_getlen(ip, iend, &matchlen)))) {
+			return -1;
+		}
+		matchlen += EVARCH_LZ_MIN_MATCH;
+		if ((0 == offset) || (offset > (size_t)(op - dst)) || ((size_t)(oend - op) < matchlen)) {
+			return -1;
+		}
+		// Byte by byte: the match may overlap what it is producing.
+		matchp = op - offset;
+		while (matchlen-- > 0) {
+			*op++ = *matchp++;
+		}
+	}
+	return op - dst;
+}
+
+/*
+ * Find a name in the dictionary of the block being built, adding it
+ * if add is set. Returns the code, -1 if absent (or no room).
+ */
+static int evarch_code(EVARCH* archp, char* name, int add) {
+	uint32_t i;
+
+	if (NULL == name) {
+		name = "";
+	}
+	for (i = 0; i < archp->ndict; i++) {
+		if (0 == strncmp(archp->dict[i], name, EVARCH_NAME_LEN - 1)) {
+			return i;
+		}
+	}
+	if (!add || (archp->ndict >= EVARCH_DICT_MAX)) {
+		return -1;
+	}
+	strncpy(archp->dict[archp->ndict], name, EVARCH_NAME_LEN - 1);
+	archp->dict[archp->ndict][EVARCH_NAME_LEN - 1] = '\0';
+	return archp->ndict++;
+}
+
+/**
+ * @brief Open an archive for appending, creating it if need be.
+ *
+ * A block left half written by a writer that died is cut off.
+ *
+ * @param dir Directory of the archive files.
+ * @param name Name of the archive.
+ * @param mode Permissions for new archive files.
+ * @return Pointer to the writer handle, NULL on error.
+ */
+EVARCH* evarch_open(char* dir, char* name, mode_t mode) {
+	char path[512];
+	struct stat st;
+	EVARCH_INDEXHDR hdr;
+	EVARCH_INDEX last;
+	uint64_t nblocks;
+	EVARCH* archp;
+
+	archp = calloc(1, sizeof(EVARCH));
+	if (NULL == archp) {
+		return NULL;
+	}
+	archp->datafd = -1;
+	archp->blockbuff = malloc(sizeof(EVARCH_BLOCKHDR) + (EVARCH_DICT_MAX * EVARCH_NAME_LEN) +
+			(EVARCH_BLOCK_EVENTS * (sizeof(int64_t) + sizeof(uint64_t) + 3)) + EVARCH_BLOCK_ALIGN);
+	archp->workbuff = malloc(2 * EVARCH_BLOCK_EVENTS * sizeof(int64_t));
+
+	evarch_path(path, sizeof(path), dir, name, "evi");
+	archp->indexfd = open(path, O_RDWR | O_CREAT, mode);
+	if ((NULL == archp->blockbuff) || (NULL == archp->workbuff) || (archp->indexfd < 0) || fstat(archp->indexfd, &st)) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to open archive index %s: errno = %d | %s", path, errno, strerror(errno));
+		evarch_close(archp);
+		return NULL;
+	}
+
+	if ((size_t)st.st_size < sizeof(hdr)) {
+		memset(&hdr, 0, sizeof(hdr));
+		hdr.magic = EVARCH_MAGIC;
+		hdr.version = EVARCH_VERSION;
+		hdr.recsize = sizeof(EVARCH_INDEX);
+		if (ftruncate(archp->indexfd, 0) || evarch_pwrite(archp->indexfd, &hdr, sizeof(hdr), 0)) {
+			ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to write archive index %s: errno = %d | %s", path, errno, strerror(errno));
+			evarch_close(archp);
+			return NULL;
+		}
+		nblocks = 0;
+	} else {
+		if ((pread(archp->indexfd, &hdr, sizeof(hdr), 0) != sizeof(hdr)) || (EVARCH_MAGIC != hdr.magic) ||
+				(EVARCH_VERSION != hdr.version) || (sizeof(EVARCH_INDEX) != hdr.recsize)) {
+			ULPPK_LOG(ULPPK_LOG_ERROR, "%s is not an event archive index of this version", path);
+			evarch_close(archp);
+			return NULL;
+		}
+		nblocks = (st.st_size - sizeof(hdr)) / sizeof(EVARCH_INDEX);
+	}
+	archp->indexlen = sizeof(hdr) + (nblocks * sizeof(EVARCH_INDEX));
+	if (ftruncate(archp->indexfd, archp->indexlen)) {
+		ULPPK_LOG(ULPPK_LOG_WARN, "Unable to trim archive index %s: errno = %d | %s", path, errno, strerror(errno));
+	}
+	if (nblocks > 0) {
+		if (pread(archp->indexfd, &last, sizeof(last), archp->indexlen - sizeof(last)) != sizeof(last)) {
+			ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to read archive index %s: errno = %d | %s", path, errno, strerror(errno));
+			evarch_close(archp);
+			return NULL;
+		}
+		archp->datalen = last.offset + last.length;
+	}
+
+	evarch_path(path, sizeof(path), dir, name, "evd");
+	archp->datafd = open(path, O_RDWR | O_CREAT, mode);
+	if ((archp->datafd < 0) || fstat(archp->datafd, &st)) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to open archive data %s: errno = %d | %s", path, errno, strerror(errno));
+		evarch_close(archp);
+		return NULL;
+	}
+	if ((uint64_t)st.st_size < archp->datalen) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Archive data %s is shorter than its index says", path);
+		evarch_close(archp);
+		return NULL;
+	}
+	if (((uint64_t)st.st_size > archp->datalen) && ftruncate(archp->datafd, archp->datalen)) {
+		ULPPK_LOG(ULPPK_LOG_WARN, "Unable to trim archive data %s: errno = %d | %s", path, errno, strerror(errno));
+	}
+	return archp;
+}
+
+/*
+ * Non-zero once the first event of the block being built is flush_secs old.
+ */
+static int evarch_due(EVARCH* archp, int64_t now) {
+	return (archp->count > 0) && (archp->flush_secs > 0) && ((now - archp->ts[0]) >= (archp->flush_secs * EVARCH_NSEC));
+}
+
+/**
+ * @brief Add an event to the archive.
+ *
+ * Events collect in memory and are written a block at a time: when the
+ * block is full, when its dictionary is, or when it has been open for
+ * flush_secs (checked as events arrive, and by evarch_flush_if_due).
+ *
+ * @param archp Writer handle.
+ * @param ts Time of the event, nsec since the epoch.
+ * @param old_state State before the event.
+ * @param new_state State after the event.
+ * @param event The event.
+ * @param serialnumber Serial number carried by the event (0 if none).
+ * @return 0 on success, -1 if a block could not be written.
+ */
+int evarch_append(EVARCH* archp, int64_t ts, char* old_state, char* new_state, char* event, uint64_t serialnumber) {
+	int status = 0;
+	int added = (evarch_code(archp, old_state, 0) < 0) + (evarch_code(archp, new_state, 0) < 0) +
+			(evarch_code(archp, event, 0) < 0);
+
+	if ((archp->count >= EVARCH_BLOCK_EVENTS) || ((archp->ndict + added) > EVARCH_DICT_MAX) || evarch_due(archp, ts)) {
+		status = evarch_flush(archp);
+	}
+	archp->ts[archp->count] = ts;
+	archp->serial[archp->count] = serialnumber;
+	archp->codes[EVARCH_COL_OLD][archp->count] = evarch_code(archp, old_state, 1);
+	archp->codes[EVARCH_COL_NEW][archp->count] = evarch_code(archp, new_state, 1);
+	archp->codes[EVARCH_COL_EVENT][archp->count] = evarch_code(archp, event, 1);
+	archp->count++;
+	return status;
+}
+
+/**
+ * @brief Write the block being built if it has been open for flush_secs.
+ * Lets an idle writer get its last events out without waiting for
+ * another one to arrive.
+ *
+ * @param archp Writer handle.
+ * @param now Current time, nsec since the epoch.
+ * @return 0 on success (or nothing due), -1 on a write error.
+ */
+int evarch_flush_if_due(EVARCH* archp, int64_t now) {
+	return evarch_due(archp, now) ? evarch_flush(archp) : 0;
+}
+
+/**
+ * @brief Write the events collected so far as a block.
+ *
+ * @param archp Writer handle.
+ * @return 0 on success (or nothing to write), -1 on a write error. The
+ * events are discarded either way.
+ */
+int evarch_flush(EVARCH* archp) {
+	EVARCH_BLOCKHDR* blockp = (EVARCH_BLOCKHDR*)archp->blockbuff;
+	EVARCH_INDEX idx;
+	unsigned char* rawp;
+	unsigned char* colp;
+	int64_t* deltas = (int64_t*)archp->workbuff;
+	size_t offset;
+	size_t raw;
+	size_t stored;
+	size_t pad;
+	uint32_t i;
+	int col;
+	int status = 0;
+
+	if (0 == archp->count) {
+		return 0;
+	}
+
+	memset(&idx, 0, sizeof(idx));
+	idx.min_ts = idx.max_ts = archp->ts[0];
+	idx.min_serial = idx.max_serial = archp->serial[0];
+	for (i = 1; i < archp->count; i++) {
+		if (archp->ts[i] < idx.min_ts) {
+			idx.min_ts = archp->ts[i];
+		}
+		if (archp->ts[i] > idx.max_ts) {
+			idx.max_ts = archp->ts[i];
+		}
+		if (archp->serial[i] < idx.min_serial) {
+			idx.min_serial = archp->serial[i];
+		}
+		if (archp->serial[i] > idx.max_serial) {
+			idx.max_serial = archp->serial[i];
+		}
+	}
+
+	memset(blockp, 0, sizeof(EVARCH_BLOCKHDR));
+	blockp->magic = EVARCH_BLOCK_MAGIC;
+	blockp->count = archp->count;
+	blockp->ndict = archp->ndict;
+	blockp->ts_base = archp->ts[0];
+	blockp->serial_base = archp->serial[0];
+	offset = sizeof(EVARCH_BLOCKHDR);
+	memcpy(archp->blockbuff + offset, archp->dict, archp->ndict * EVARCH_NAME_LEN);
+	offset += archp->ndict * EVARCH_NAME_LEN;
+
+	for (col = 0; col < EVARCH_NCOLS; col++) {
+		raw = archp->count * evarch_col_width[col];
+		if (EVARCH_COL_TIME == col) {
+			deltas[0] = 0;
+			for (i = 1; i < archp->count; i++) {
+				deltas[i] = archp->ts[i] - archp->ts[i - 1];
+			}
+		} else if (EVARCH_COL_SERIAL == col) {
+			deltas[0] = 0;
+			for (i = 1; i < archp->count; i++) {
+				deltas[i] = (int64_t)(archp->serial[i] - archp->serial[i - 1]);
+			}
+		}
+		if (evarch_col_width[col] > 1) {
+			rawp = archp->workbuff + (EVARCH_BLOCK_EVENTS * sizeof(int64_t));
+			evarch_shuffle((unsigned char*)deltas, rawp, archp->count, evarch_col_width[col]);
+		} else {
+			rawp = archp->codes[col];
+		}
+
+		// Keep the compressed column only if it is smaller.
+		colp = archp->blockbuff + offset;
+		stored = evarch_lz_compress(rawp, raw, colp, raw - 1);
+		if (0 == stored) {
+			memcpy(colp, rawp, raw);
+			stored = raw;
+		}
+		blockp->cols[col].offset = offset;
+		blockp->cols[col].stored = stored;
+		blockp->cols[col].raw = raw;
+		offset += stored;
+	}
+
+	// Pad so the next block, and the header a reader maps, is aligned.
+	pad = (EVARCH_BLOCK_ALIGN - (offset % EVARCH_BLOCK_ALIGN)) % EVARCH_BLOCK_ALIGN;
+	memset(archp->blockbuff + offset, 0, pad);
+	offset += pad;
+
+	idx.offset = archp->datalen;
+	idx.length = offset;
+	idx.count = archp->count;
+	if (evarch_pwrite(archp->datafd, archp->blockbuff, offset, archp->datalen) ||
+			evarch_pwrite(archp->indexfd, &idx, sizeof(idx), archp->indexlen)) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to write archive block of %u events: errno = %d | %s",
+				archp->count, errno, strerror(errno));
+		status = -1;
+	} else {
+		archp->datalen += offset;
+		archp->indexlen += sizeof(idx);
+	}
+	archp->count = 0;
+	archp->ndict = 0;
+	return status;
+}
+
+/**
+ * @brief Flush and close an archive writer.
+ *
+ * @param archp Writer handle.
+ */
+void evarch_close(EVARCH* archp) {
+	if (NULL == archp) {
+		return;
+	}
+	if ((archp->datafd >= 0) && (archp->indexfd >= 0) && (NULL != archp->blockbuff) && (NULL != archp->workbuff)) {
+		evarch_flush(archp);
+	}
+	if (archp->datafd >= 0) {
+		close(archp->datafd);
+	}
+	if (archp->indexfd >= 0) {
+		close(archp->indexfd);
+	}
+	free(archp->blockbuff);
+	free(archp->workbuff);
+	free(archp);
+}
+
+/*
+ * Map a whole file read only. An empty file maps to NULL.
+ */
+static int evarch_map(char* path, unsigned char** mappp, size_t* lenp) {
+	int fd;
+	struct stat st;
+	void* mapp = NULL;
+
+	fd = open(path, O_RDONLY);
+	if ((fd < 0) || fstat(fd, &st)) {
+		if (fd >= 0) {
+			close(fd);
+		}
+		return -1;
+	}
+	if (st.st_size > 0) {
+		mapp = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (MAP_FAILED == mapp) {
+			close(fd);
+			return -1;
+		}
+	}
+	close(fd);
+	*mappp = mapp;
+	*lenp = st.st_size;
+	return 0;
+}
+
+/**
+ * @brief Open an archive for reading. The reader sees the blocks
+ * indexed at the time it is opened.
+ *
+ * @param dir Directory of the archive files.
+ * @param name Name of the archive.
+ * @return Pointer to the reader handle, NULL on error.
+ */
+EVARCH_READER* evarch_open_reader(char* dir, char* name) {
+	char path[512];
+	EVARCH_READER* readerp;
+	unsigned char* mapp;
+	uint32_t i;
+
+	readerp = calloc(1, sizeof(EVARCH_READER));
+	if (NULL == readerp) {
+		return NULL;
+	}
+	readerp->workbuff = malloc(EVARCH_BLOCK_EVENTS * sizeof(int64_t));
+
+	evarch_path(path, sizeof(path), dir, name, "evi");
+	if ((NULL == readerp->workbuff) || evarch_map(path, &mapp, &readerp->indexlen)) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to open archive index %s: errno = %d | %s", path, errno, strerror(errno));
+		evarch_close_reader(readerp);
+		return NULL;
+	}
+	readerp->indexhdrp = (EVARCH_INDEXHDR*)mapp;
+	if ((readerp->indexlen < sizeof(EVARCH_INDEXHDR)) || (EVARCH_MAGIC != readerp->indexhdrp->magic) ||
+			(EVARCH_VERSION != readerp->indexhdrp->version) || (sizeof(EVARCH_INDEX) != readerp->indexhdrp->recsize)) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "%s is not an event archive index of this version", path);
+		evarch_close_reader(readerp);
+		return NULL;
+	}
+	readerp->index = (EVARCH_INDEX*)(readerp->indexhdrp + 1);
+
+	evarch_path(path, sizeof(path), dir, name, "evd");
+	if (evarch_map(path, &readerp->datap, &readerp->datalen)) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to open archive data %s: errno = %d | %s", path, errno, strerror(errno));
+		evarch_close_reader(readerp);
+		return NULL;
+	}
+
+	// Only blocks that are wholly in the data file.
+	readerp->nblocks = (readerp->indexlen - sizeof(EVARCH_INDEXHDR)) / sizeof(EVARCH_INDEX);
+	for (i = 0; i < readerp->nblocks; i++) {
+		if ((readerp->index[i].offset + readerp->index[i].length) > readerp->datalen) {
+			readerp->nblocks = i;
+			break;
+		}
+	}
+	return readerp;
+}
+
+/**
+ * @brief Locate a block.
+ *
+ * @param readerp Reader handle.
+ * @param blockno Block number (index record number).
+ * @return Pointer to the mapped block header, NULL if the block is bad.
+ */
+EVARCH_BLOCKHDR* evarch_block(EVARCH_READER* readerp, uint32_t blockno) {
+	EVARCH_INDEX* idxp;
+	EVARCH_BLOCKHDR* blockp;
+	int col;
+
+	if (blockno >= readerp->nblocks) {
+		return NULL;
+	}
+	idxp = &readerp->index[blockno];
+	if ((idxp->offset % EVARCH_BLOCK_ALIGN) || (idxp->length < sizeof(EVARCH_BLOCKHDR))) {
+		return NULL;
+	}
+	blockp = (EVARCH_BLOCKHDR*)(readerp->datap + idxp->offset);
+	if ((EVARCH_BLOCK_MAGIC != blockp->magic) ||
+			(blockp->count != idxp->count) || (blockp->count > EVARCH_BLOCK_EVENTS) ||
+			(blockp->ndict > EVARCH_DICT_MAX) ||
+			((sizeof(EVARCH_BLOCKHDR) + (blockp->ndict * EVARCH_NAME_LEN)) > idxp->length)) {
+		return NULL;
+	}
+	for (col = 0; col < EVARCH_NCOLS; col++) {
+		if (((uint64_t)blockp->cols[col].offset + blockp->cols[col].stored > idxp->length) ||
+				(blockp->cols[col].raw != (blockp->count * evarch_col_width[col])) ||
+				(blockp->cols[col].stored > blockp->cols[col].raw)) {
+			return NULL;
+		}
+	}
+	return blockp;
+}
+
+/**
+ * @brief Look up a name in a block's dictionary.
+ *
+ * @return The name's code, -1 if no event in the block uses it.
+ */
+int evarch_dict_code(EVARCH_BLOCKHDR* blockp, char* name) {
+	char* dictp = (char*)(blockp + 1);
+	uint32_t i;
+
+	for (i = 0; i < blockp->ndict; i++) {
+		if (0 == strncmp(dictp + (i * EVARCH_NAME_LEN), name, EVARCH_NAME_LEN - 1)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief The name for a code in a block's dictionary.
+ *
+ * @return The name, "?" for a code outside the dictionary.
+ */
+char* evarch_dict_name(EVARCH_BLOCKHDR* blockp, int code) {
+	if ((code < 0) || ((uint32_t)code >= blockp->ndict)) {
+		return "?";
+	}
+	return (char*)(blockp + 1) + (code * EVARCH_NAME_LEN);
+}
+
+/**
+ * @brief Inflate one column of a block.
+ *
+ * The time column comes back as int64_t nsec since the epoch, the
+ * serial number column as uint64_t, the others as one byte dictionary
+ * codes.
+ *
+ * @param readerp Reader handle.
+ * @param blockno Block number.
+ * @param col EVARCH_COL_xxx
+ * @param outp Room for EVARCH_BLOCK_EVENTS values of the column.
+ * @return Number of values, -1 if the block is bad.
+ */
+int evarch_read_column(EVARCH_READER* readerp, uint32_t blockno, int col, void* outp) {
+	EVARCH_BLOCKHDR* blockp;
+	EVARCH_COLUMN* colp;
+	unsigned char* rawp;
+	int64_t* values = outp;
+	uint32_t i;
+
+	blockp = evarch_block(readerp, blockno);
+	if ((NULL == blockp) || (col < 0) || (col >= EVARCH_NCOLS)) {
+		return -1;
+	}
+	colp = &blockp->cols[col];
+	rawp = (evarch_col_width[col] > 1) ? readerp->workbuff : outp;
+	if (colp->stored == colp->raw) {
+		memcpy(rawp, (unsigned char*)blockp + colp->offset, colp->raw);
+	} else if (evarch_lz_decompress((unsigned char*)blockp + colp->offset, colp->stored, rawp, colp->raw) != colp->raw) {
+		return -1;
+	}
+	if (evarch_col_width[col] == 1) {
+		return blockp->count;
+	}
+
+	evarch_unshuffle(rawp, outp, blockp->count, evarch_col_width[col]);
+	if (blockp->count > 0) {
+		values[0] = (EVARCH_COL_TIME == col) ? blockp->ts_base : (int64_t)blockp->serial_base;
+	}
+	for (i = 1; i < blockp->count; i++) {
+		values[i] = (int64_t)((uint64_t)values[i - 1] + (uint64_t)values[i]);
+	}
+	return blockp->count;
+}
+
+/**
+ * @brief Close an archive reader.
+ *
+ * @param readerp Reader handle.
+ */
+void evarch_close_reader(EVARCH_READER* readerp) {
+	if (NULL == readerp) {
+		return;
+	}
+	if (NULL != readerp->indexhdrp) {
+		munmap(readerp->indexhdrp, readerp->indexlen);
+	}
+	if (NULL != readerp->datap) {
+		munmap(readerp->datap, readerp->datalen);
+	}
+	free(readerp->workbuff);
+	free(readerp);
+}
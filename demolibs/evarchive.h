@@ -0,0 +1,183 @@
+/*
+ *****************************************************************
+
+<GPL>
+
+Copyright: © 2001-2015 Robert C Garvey
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+ .
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ .
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+X-Comment: On Debian systems, the complete text of the GNU General Public
+ License can be found in `/usr/share/common-licenses/GPL-3'.
+
+</GPL>
+*********************************************************************
+*/
+
+
+/**
+ * @file evarchive.h
+ *
+ * @brief Append only, block compressed archive of processed events.
+ *
+ * An archive is two files in one directory. <name>.evd holds blocks of
+ * up to EVARCH_BLOCK_EVENTS events stored column by column: time,
+ * serial number, old state, new state and event. The names are coded
+ * as one byte indexes into a small dictionary kept with each block,
+ * and each column is compressed on its own, so a query only inflates
+ * the columns it looks at. <name>.evi is an array of fixed size index
+ * records, one per block, with the block's time and serial number
+ * range. Readers map both files and skip whole blocks on the index
+ * (or on the dictionary) without reading them.
+ * <p>
+ * A block is written to the data file before its index record, and
+ * the index record is what makes it part of the archive. A writer that
+ * dies mid block leaves a tail that the next writer cuts off.
+ */
+/*
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef EVARCHIVE_H_
+#define EVARCHIVE_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EVARCH_MAGIC 0x45564931			///< "EVI1" ... index file header
+#define EVARCH_BLOCK_MAGIC 0x45564231	///< "EVB1" ... start of each data block
+#define EVARCH_VERSION 2				///< 2: blocks start on EVARCH_BLOCK_ALIGN boundaries
+#define EVARCH_NAME_LEN 32				///< Room for a state or event name, including the NUL
+#define EVARCH_BLOCK_EVENTS 8192		///< Events per block
+#define EVARCH_DICT_MAX 256				///< Names per block dictionary (codes are one byte)
+#define EVARCH_BLOCK_ALIGN 8			///< Blocks are padded to a multiple of this, so mapped headers are aligned
+
+/**
+ * @brief Block columns.
+ */
+enum {
+	EVARCH_COL_TIME = 0,		///< int64 nsec since the previous event (first: since tv_base)
+	EVARCH_COL_SERIAL,			///< int64 difference from the previous serial number
+	EVARCH_COL_OLD,				///< uint8 dictionary code of the state before the event
+	EVARCH_COL_NEW,				///< uint8 dictionary code of the state after the event
+	EVARCH_COL_EVENT,			///< uint8 dictionary code of the event
+	EVARCH_NCOLS
+};
+
+/**
+ * @brief Where a column lives in its block.
+ */
+typedef struct {
+	uint32_t offset;			///< From the start of the block
+	uint32_t stored;			///< Bytes in the file. Equal to raw: stored uncompressed
+	uint32_t raw;				///< Bytes once inflated
+	uint32_t pad;
+} EVARCH_COLUMN;
+
+/**
+ * @brief Block header. Followed by ndict names of EVARCH_NAME_LEN
+ * bytes, then the column data, then zero padding up to a multiple of
+ * EVARCH_BLOCK_ALIGN bytes.
+ */
+typedef struct {
+	uint32_t magic;
+	uint32_t count;				///< Events in the block
+	uint32_t ndict;				///< Names in the dictionary
+	uint32_t pad;
+	int64_t ts_base;			///< Time of the first event, nsec since the epoch
+	uint64_t serial_base;		///< Serial number of the first event
+	EVARCH_COLUMN cols[EVARCH_NCOLS];
+} EVARCH_BLOCKHDR;
+
+/**
+ * @brief Index file header. The index records follow it.
+ */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t recsize;			///< sizeof(EVARCH_INDEX) of the writer
+	uint32_t pad[13];
+} EVARCH_INDEXHDR;
+
+/**
+ * @brief One index record per block. 64 bytes.
+ */
+typedef struct {
+	uint64_t offset;			///< Of the block in the data file
+	uint32_t length;			///< Of the block in the data file, padding included
+	uint32_t count;				///< Events in the block
+	int64_t min_ts;				///< nsec since the epoch
+	int64_t max_ts;
+	uint64_t min_serial;
+	uint64_t max_serial;
+	char pad[16];
+} EVARCH_INDEX;
+
+/**
+ * @brief Writer handle. Holds the block being filled.
+ */
+typedef struct {
+	int datafd;
+	int indexfd;
+	uint64_t datalen;			///< Data file length: offset of the next block
+	uint64_t indexlen;			///< Index file length: offset of the next index record
+	int flush_secs;				///< Write a partial block once its first event is this old (0: only when full)
+	uint32_t count;
+	uint32_t ndict;
+	char dict[EVARCH_DICT_MAX][EVARCH_NAME_LEN];
+	int64_t ts[EVARCH_BLOCK_EVENTS];
+	uint64_t serial[EVARCH_BLOCK_EVENTS];
+	uint8_t codes[EVARCH_NCOLS][EVARCH_BLOCK_EVENTS];	///< Only the name columns are used
+	unsigned char* blockbuff;	///< Assembles a block for writing
+	unsigned char* workbuff;	///< Delta/byte plane scratch
+} EVARCH;
+
+/**
+ * @brief Reader handle. Both files are mapped read only.
+ */
+typedef struct {
+	unsigned char* datap;
+	size_t datalen;
+	EVARCH_INDEXHDR* indexhdrp;
+	size_t indexlen;
+	EVARCH_INDEX* index;
+	uint32_t nblocks;			///< Blocks in the archive when it was opened
+	unsigned char* workbuff;	///< Inflated column scratch
+} EVARCH_READER;
+
+EVARCH* evarch_open(char* dir, char* name, mode_t mode);
+int evarch_append(EVARCH* archp, int64_t ts, char* old_state, char* new_state, char* event, uint64_t serialnumber);
+int evarch_flush(EVARCH* archp);
+int evarch_flush_if_due(EVARCH* archp, int64_t now);
+void evarch_close(EVARCH* archp);
+
+EVARCH_READER* evarch_open_reader(char* dir, char* name);
+EVARCH_BLOCKHDR* evarch_block(EVARCH_READER* readerp, uint32_t blockno);
+int evarch_dict_code(EVARCH_BLOCKHDR* blockp, char* name);
+char* evarch_dict_name(EVARCH_BLOCKHDR* blockp, int code);
+int evarch_read_column(EVARCH_READER* readerp, uint32_t blockno, int col, void* outp);
+void evarch_close_reader(EVARCH_READER* readerp);
+
+size_t evarch_lz_compress(const unsigned char* src, size_t srclen, unsigned char* dst, size_t dstcap);
+ssize_t evarch_lz_decompress(const unsigned char* src, size_t srclen, unsigned char* dst, size_t dstlen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EVARCHIVE_H_ */
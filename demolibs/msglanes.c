@@ -0,0 +1,686 @@
+/*
+ *****************************************************************
+
+<GPL>
+
+Copyright: © 2001-2015 Robert C Garvey
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+ .
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ .
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+X-Comment: On Debian systems, the complete text of the GNU General Public
+ License can be found in `/usr/share/common-licenses/GPL-3'.
+
+</GPL>
+*********************************************************************
+*/
+
+/**
+ * @file msglanes.c
+ *
+ * @brief Priority lanes layered over ulppk byte stream message deques.
+ *
+ * Lane N of lane set "name" is the msgdeque "name-laneN". Senders push
+ * the message onto the lane deque first, then bump the lane's pending
+ * count and ring the doorbell. The receiver waits on the doorbell, picks
+ * a lane with a non-zero pending count and only then reads that lane's
+ * deque, so the read never blocks behind an empty lane.
+ *
+ * Higher lane numbers are served first. To keep a flood on a high lane
+ * from starving the lanes below it, after "burst" consecutive receives
+ * from one lane the receiver serves one message from the next lower
+ * lane that has anything pending.
+ *
+ * There are two sets of lane deques, "name-0-laneN" and "name-1-laneN",
+ * selected by the low bit of the epoch. Restarting the receiver or
+ * resizing the lanes builds the other set and bumps the epoch; senders
+ * notice the new epoch on their next send and reattach.
+ */
+/*
+ *  Created on: Oct 19, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <ulppk_log.h>
+#include <msgdeque.h>
+#include <msglanes.h>
+
+// Used when MMDQ_DIR_PATH is not in the environment. Matches the
+// mmdq_dir setting shipped in the demo ini files.
+#define MSGLANES_DEFAULT_DIR "/var/ulppk2-demo/memfiles"
+
+/*
+ * Build the path of the control file for lane set "name".
+ */
+static void msglanes_ctl_path(char* pathbuff, size_t buffsize, char* name) {
+	char* dirp;
+
+	dirp = getenv("MMDQ_DIR_PATH");
+	if (NULL == dirp) {
+		dirp = MSGLANES_DEFAULT_DIR;
+	}
+	snprintf(pathbuff, buffsize, "%s/%s.lanes", dirp, name);
+}
+
+/*
+ * Build the msgdeque name of one lane of the set used in epoch.
+ */
+static void msglanes_lane_name(char* namebuff, size_t buffsize, char* name, unsigned int epoch, int lane) {
+	snprintf(namebuff, buffsize, "%s-%u-lane%d", name, epoch & 1, lane);
+}
+
+/*
+ * Create the lane deques of the set used in epoch.
+ */
+static int msglanes_create_lanes(MSGCELL** lanes, char* name, unsigned int epoch, mode_t mode, size_t size, int nlanes) {
+	char lanename[MSGLANES_NAME_MAX + 16];
+	int lane;
+
+	for (lane = 0; lane < nlanes; lane++) {
+		msglanes_lane_name(lanename, sizeof(lanename), name, epoch, lane);
+		lanes[lane] = msgdeque_create_byte_stream(lanename, mode, size);
+		if (NULL == lanes[lane]) {
+			ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to create lane deque %s", lanename);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Sum of the pending counts of one set.
+ */
+static int msglanes_set_pending(MSGLANES_CTL* ctlp, int set) {
+	int lane;
+	int total = 0;
+
+	for (lane = 0; lane < ctlp->nlanes; lane++) {
+		total += ctlp->pending[set][lane];
+	}
+	return total;
+}
+
+/*
+ * Map the control file. Creates and sizes the file if create is non-zero.
+ */
+static MSGLANES_CTL* msglanes_map_ctl(char* name, mode_t mode, int create) {
+	char path[512];
+	int fd;
+	MSGLANES_CTL* ctlp;
+
+	msglanes_ctl_path(path, sizeof(path), name);
+	fd = create ? open(path, O_RDWR | O_CREAT, mode) : open(path, O_RDWR);
+	if (fd < 0) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to open lane control file %s: errno = %d | %s",
+				path, errno, strerror(errno));
+		return NULL;
+	}
+	if (create && ftruncate(fd, sizeof(MSGLANES_CTL))) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to size lane control file %s: errno = %d | %s",
+				path, errno, strerror(errno));
+		close(fd);
+		return NULL;
+	}
+	ctlp = mmap(NULL, sizeof(MSGLANES_CTL), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (MAP_FAILED == ctlp) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to map lane control file %s: errno = %d | %s",
+				path, errno, strerror(errno));
+		return NULL;
+	}
+	return ctlp;
+}
+
+/*
+ * Wait for senders that got past the closed check to finish their send.
+ *
+ * A sender killed part way through a send never clears its slot, so a
+ * slot whose process is gone is released, and a live one is given up
+ * on after MSGLANES_INFLIGHT_WAIT msec. Either way a message may be in
+ * its lane deque without being counted as pending; that is logged.
+ */
+static void msglanes_wait_inflight(MSGLANES_CTL* ctlp) {
+	int slot;
+	long waited;
+	pid_t pid;
+	struct timespec start;
+	struct timespec now;
+
+	__sync_synchronize();
+	for (slot = 0; slot < MSGLANES_INFLIGHT_SLOTS; slot++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		while (0 != (pid = ctlp->inflight[slot])) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			waited = ((now.tv_sec - start.tv_sec) * 1000) + ((now.tv_nsec - start.tv_nsec) / 1000000);
+			if (kill(pid, 0) && (ESRCH == errno)) {
+				ULPPK_LOG(ULPPK_LOG_WARN, "Lane sender pid %d died part way through a send ... released", (int)pid);
+				__sync_bool_compare_and_swap(&ctlp->inflight[slot], pid, 0);
+			} else if (waited >= MSGLANES_INFLIGHT_WAIT) {
+				ULPPK_LOG(ULPPK_LOG_WARN, "Lane sender pid %d stuck part way through a send for %ld msec ... not waiting for it",
+						(int)pid, waited);
+				__sync_bool_compare_and_swap(&ctlp->inflight[slot], pid, 0);
+			} else {
+				usleep(1000);
+			}
+		}
+	}
+}
+
+/*
+ * Finish a resize once the previous set is drained: let go of its
+ * deques and go back to reading the current set only.
+ */
+static void msglanes_finish_resize(MSGLANES* lanesp) {
+	int lane;
+
+	if (!lanesp->resizing || (msglanes_set_pending(lanesp->ctlp, (lanesp->epoch - 1) & 1) > 0)) {
+		return;
+	}
+	for (lane = 0; lane < lanesp->ctlp->nlanes; lane++) {
+		if (NULL != lanesp->old_lanes[lane]) {
+			msgdeque_detach(lanesp->old_lanes[lane]);
+			lanesp->old_lanes[lane] = NULL;
+		}
+	}
+	lanesp->resizing = 0;
+}
+
+/*
+ * Wait for the doorbell, for no more than lanesp->timeout msec if set.
+ */
+static int msglanes_wait_doorbell(MSGLANES* lanesp) {
+	struct timespec deadline;
+
+	if (lanesp->timeout <= 0) {
+		return sem_wait(&lanesp->ctlp->doorbell);
+	}
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += lanesp->timeout / 1000;
+	deadline.tv_nsec += (lanesp->timeout % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	return sem_timedwait(&lanesp->ctlp->doorbell, &deadline);
+}
+
+/*
+ * Take an inflight slot for the calling process. Returns the slot.
+ */
+static int msglanes_enter(MSGLANES_CTL* ctlp, pid_t pid) {
+	int start = pid % MSGLANES_INFLIGHT_SLOTS;
+	int i;
+
+	while (1) {
+		for (i = 0; i < MSGLANES_INFLIGHT_SLOTS; i++) {
+			if (__sync_bool_compare_and_swap(&ctlp->inflight[(start + i) % MSGLANES_INFLIGHT_SLOTS], 0, pid)) {
+				return (start + i) % MSGLANES_INFLIGHT_SLOTS;
+			}
+		}
+		sched_yield();		// every slot busy: sends are short, try again
+	}
+}
+
+/*
+ * (Re)attach the lane deques of the epoch currently in the control block.
+ */
+static int msglanes_attach_lanes(MSGLANES* lanesp) {
+	MSGLANES_CTL* ctlp = lanesp->ctlp;
+	char lanename[MSGLANES_NAME_MAX + 16];
+	unsigned int epoch = ctlp->epoch;
+	int lane;
+
+	for (lane = 0; lane < ctlp->nlanes; lane++) {
+		// Let go of the previous epoch's deque first, or a long lived
+		// sender keeps a mapping per lane for every restart or resize.
+		if (NULL != lanesp->lanes[lane]) {
+			msgdeque_detach(lanesp->lanes[lane]);
+			lanesp->lanes[lane] = NULL;
+		}
+		msglanes_lane_name(lanename, sizeof(lanename), lanesp->name, epoch, lane);
+		lanesp->lanes[lane] = msgdeque_attach(lanename);
+		if (NULL == lanesp->lanes[lane]) {
+			ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to attach to lane deque %s", lanename);
+			return -1;
+		}
+	}
+	lanesp->epoch = epoch;
+	return 0;
+}
+
+/*
+ * Take over what a previous receiver left behind in the control block.
+ *
+ * Messages still pending in the previous receiver's current set are
+ * kept: its lane deques are attached as the old set, to be drained
+ * before the new one exactly as after a resize. Anything that can't be
+ * kept (the set before that, which the new lanes are about to replace,
+ * lanes beyond the new lane count, or a lane deque that won't attach)
+ * is counted and logged as discarded. Returns the number of messages
+ * kept. Senders must already be held off.
+ */
+static int msglanes_adopt(MSGLANES* lanesp, int nlanes) {
+	MSGLANES_CTL* ctlp = lanesp->ctlp;
+	char lanename[MSGLANES_NAME_MAX + 16];
+	unsigned int oldepoch = lanesp->epoch - 1;
+	int oldset = oldepoch & 1;
+	int oldnlanes = ctlp->nlanes;
+	int discarded;
+	int kept = 0;
+	int lane;
+
+	if ((oldnlanes < 1) || (oldnlanes > MSGLANES_MAX_LANES)) {
+		oldnlanes = MSGLANES_MAX_LANES;
+	}
+	discarded = msglanes_set_pending(ctlp, lanesp->epoch & 1);
+	for (lane = 0; lane < MSGLANES_MAX_LANES; lane++) {
+		ctlp->pending[lanesp->epoch & 1][lane] = 0;
+		if (ctlp->pending[oldset][lane] <= 0) {
+			ctlp->pending[oldset][lane] = 0;
+			continue;
+		}
+		if ((lane < nlanes) && (lane < oldnlanes)) {
+			msglanes_lane_name(lanename, sizeof(lanename), lanesp->name, oldepoch, lane);
+			lanesp->old_lanes[lane] = msgdeque_attach(lanename);
+		}
+		if (NULL == lanesp->old_lanes[lane]) {
+			discarded += ctlp->pending[oldset][lane];
+			ctlp->pending[oldset][lane] = 0;
+			continue;
+		}
+		kept += ctlp->pending[oldset][lane];
+	}
+	if (discarded > 0) {
+		ULPPK_LOG(ULPPK_LOG_WARN, "Lane set %s: discarding %d messages left by the previous receiver",
+				lanesp->name, discarded);
+	}
+	lanesp->resizing = (kept > 0);
+	return kept;
+}
+
+/**
+ * @brief Create a lane set. Called by the (single) receiver.
+ *
+ * @param name Name of the lane set.
+ * @param mode Permissions for the lane deques and control file.
+ * @param size Size in bytes of each lane deque.
+ * @param nlanes Number of lanes (1 to MSGLANES_MAX_LANES). Lane nlanes - 1
+ * has the highest priority.
+ * @param burst Number of consecutive receives from one lane before a
+ * lower lane with pending messages gets a turn. 0 disables the guard.
+ * @return Pointer to the lane set handle, NULL on error.
+ * <p>
+ * Messages a previous receiver left pending are received first, as
+ * after msglanes_resize.
+ */
+MSGLANES* msglanes_create(char* name, mode_t mode, size_t size, int nlanes, int burst) {
+	MSGLANES* lanesp;
+	MSGLANES_CTL* ctlp;
+	unsigned int epoch;
+	int adopt;
+	int kept = 0;
+	int lane;
+
+	if ((nlanes < 1) || (nlanes > MSGLANES_MAX_LANES)) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Lane set %s: invalid lane count %d", name, nlanes);
+		return NULL;
+	}
+	ctlp = msglanes_map_ctl(name, mode, 1);
+	if (NULL == ctlp) {
+		return NULL;
+	}
+
+	// If a previous receiver left the control block behind, senders may
+	// still be attached to it. Hold them off while the lanes are rebuilt.
+	adopt = (MSGLANES_MAGIC == ctlp->magic);
+	if (adopt) {
+		epoch = ctlp->epoch + 1;
+		ctlp->closed = 1;
+		msglanes_wait_inflight(ctlp);
+	} else {
+		// New, or left by an older layout: start from a clean block.
+		memset(ctlp, 0, sizeof(MSGLANES_CTL));
+		ctlp->closed = 1;
+		epoch = 1;
+	}
+
+	lanesp = calloc(1, sizeof(MSGLANES));
+	strncpy(lanesp->name, name, sizeof(lanesp->name) - 1);
+	lanesp->ctlp = ctlp;
+	lanesp->epoch = epoch;
+	lanesp->mode = mode;
+	lanesp->streak_lane = -1;
+
+	// Before the new lanes are created: they replace the deques of the
+	// set before the previous receiver's current one.
+	if (adopt) {
+		kept = msglanes_adopt(lanesp, nlanes);
+	}
+	if (msglanes_create_lanes(lanesp->lanes, name, epoch, mode, size, nlanes)) {
+		for (lane = 0; lane < MSGLANES_MAX_LANES; lane++) {
+			if (NULL != lanesp->old_lanes[lane]) {
+				msgdeque_detach(lanesp->old_lanes[lane]);
+			}
+		}
+		munmap(ctlp, sizeof(MSGLANES_CTL));
+		free(lanesp);
+		return NULL;
+	}
+
+	// Initialize the control block last. Senders check the magic
+	// number before trusting anything else in it, and the closed
+	// flag before touching the lanes.
+	ctlp->nlanes = nlanes;
+	ctlp->burst = burst;
+	ctlp->rejected = 0;
+	ctlp->lane_size = size;
+	sem_init(&ctlp->doorbell, 1, kept);
+	ctlp->epoch = epoch;
+	__sync_synchronize();
+	ctlp->magic = MSGLANES_MAGIC;
+	ctlp->closed = 0;
+	__sync_synchronize();
+	return lanesp;
+}
+
+/**
+ * @brief Attach to a lane set created by the receiver. Called by senders.
+ *
+ * @param name Name of the lane set.
+ * @return Pointer to the lane set handle, NULL on error.
+ */
+MSGLANES* msglanes_attach(char* name) {
+	MSGLANES* lanesp;
+	MSGLANES_CTL* ctlp;
+
+	ctlp = msglanes_map_ctl(name, 0, 0);
+	if (NULL == ctlp) {
+		return NULL;
+	}
+	if (MSGLANES_MAGIC != ctlp->magic) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Lane set %s has not been initialized", name);
+		munmap(ctlp, sizeof(MSGLANES_CTL));
+		return NULL;
+	}
+	lanesp = calloc(1, sizeof(MSGLANES));
+	strncpy(lanesp->name, name, sizeof(lanesp->name) - 1);
+	lanesp->ctlp = ctlp;
+	lanesp->streak_lane = -1;
+
+	if (msglanes_attach_lanes(lanesp)) {
+		munmap(ctlp, sizeof(MSGLANES_CTL));
+		free(lanesp);
+		return NULL;
+	}
+	return lanesp;
+}
+
+/**
+ * @brief Send a message on one lane.
+ *
+ * @param lanesp Pointer to the lane set handle.
+ * @param lane Lane number. Out of range values are clamped to the
+ * nearest valid lane.
+ * @param buff Message bytes.
+ * @param len Message length in bytes.
+ * @return 0 on success, non-zero on error (see lanesp->errcode).
+ * errcode is ESHUTDOWN if the receiver has closed the lane set.
+ */
+int msglanes_send_byte_stream(MSGLANES* lanesp, int lane, char* buff, size_t len) {
+	MSGLANES_CTL* ctlp = lanesp->ctlp;
+	int retval = 0;
+	pid_t pid = getpid();
+	int slot;
+
+	// Announce ourselves before looking at the closed flag. The
+	// receiver sets closed and then waits for every inflight slot to
+	// clear, so a message is either refused here or counted in pending.
+	slot = msglanes_enter(ctlp, pid);
+	if (ctlp->closed) {
+		__sync_fetch_and_add(&ctlp->rejected, 1);
+		lanesp->errcode = ESHUTDOWN;
+		retval = -1;
+	} else if ((lanesp->epoch != ctlp->epoch) && msglanes_attach_lanes(lanesp)) {
+		// The receiver restarted or resized and we can't find its new lanes.
+		lanesp->errcode = ENOENT;
+		retval = -1;
+	} else {
+		if (lane < 0) {
+			lane = 0;
+		} else if (lane >= ctlp->nlanes) {
+			lane = ctlp->nlanes - 1;
+		}
+		if (msgdeque_send_byte_stream(lanesp->lanes[lane], buff, len)) {
+			lanesp->errcode = lanesp->lanes[lane]->errcode;
+			retval = -1;
+		} else {
+			__sync_fetch_and_add(&ctlp->pending[lanesp->epoch & 1][lane], 1);
+			sem_post(&ctlp->doorbell);
+		}
+	}
+	// Only if it is still ours: a receiver that gave up on us may have
+	// released it for another sender.
+	__sync_bool_compare_and_swap(&ctlp->inflight[slot], pid, 0);
+	return retval;
+}
+
+/*
+ * Choose the lane of a set to serve next.
+ */
+static int msglanes_pick(MSGLANES* lanesp, int set) {
+	MSGLANES_CTL* ctlp = lanesp->ctlp;
+	int top;
+	int lane;
+
+	for (top = ctlp->nlanes - 1; top > 0; top--) {
+		if (ctlp->pending[set][top] > 0) {
+			break;
+		}
+	}
+
+	// Starvation guard: the top lane has had its burst, so give
+	// the next lower lane with traffic one turn.
+	if ((ctlp->burst > 0) && (top == lanesp->streak_lane) && (lanesp->streak >= ctlp->burst)) {
+		for (lane = top - 1; lane >= 0; lane--) {
+			if (ctlp->pending[set][lane] > 0) {
+				lanesp->streak = 0;
+				return lane;
+			}
+		}
+	}
+	if (top == lanesp->streak_lane) {
+		lanesp->streak++;
+	} else {
+		lanesp->streak_lane = top;
+		lanesp->streak = 1;
+	}
+	return top;
+}
+
+/**
+ * @brief Receive the next message from a lane set, highest lane first.
+ * Blocks until a message is available on some lane, a signal
+ * is caught or the timeout (see msglanes_set_timeout) runs out.
+ *
+ * @param lanesp Pointer to the lane set handle.
+ * @param bytes_received Receives the message length.
+ * @param lanep If not NULL, receives the lane the message came from.
+ * @return Pointer to the message on the heap (caller frees), NULL on error
+ * or interruption (lanesp->errcode is EINTR, also after msglanes_wake,
+ * or ETIMEDOUT).
+ */
+char* msglanes_rec_byte_stream(MSGLANES* lanesp, size_t* bytes_received, int* lanep) {
+	MSGLANES_CTL* ctlp = lanesp->ctlp;
+	int set;
+	int lane;
+
+	if (msglanes_wait_doorbell(lanesp)) {
+		lanesp->errcode = errno;
+		return NULL;
+	}
+
+	// Rung by msglanes_wake rather than a sender.
+	if (0 == msglanes_pending(lanesp)) {
+		lanesp->errcode = EINTR;
+		return NULL;
+	}
+
+	// Senders bump a pending count before ringing the doorbell, so
+	// some lane has a message. Anything left in the previous set after
+	// a resize is older than everything in the current set; drain it first.
+	if (lanesp->resizing) {
+		set = (lanesp->epoch - 1) & 1;
+		if (msglanes_set_pending(ctlp, set) > 0) {
+			lane = msglanes_pick(lanesp, set);
+			__sync_fetch_and_sub(&ctlp->pending[set][lane], 1);
+			if (NULL != lanep) {
+				*lanep = lane;
+			}
+			return msgdeque_rec_byte_stream(lanesp->old_lanes[lane], bytes_received);
+		}
+		msglanes_finish_resize(lanesp);
+	}
+
+	set = lanesp->epoch & 1;
+	lane = msglanes_pick(lanesp, set);
+	__sync_fetch_and_sub(&ctlp->pending[set][lane], 1);
+	if (NULL != lanep) {
+		*lanep = lane;
+	}
+	return msgdeque_rec_byte_stream(lanesp->lanes[lane], bytes_received);
+}
+
+/**
+ * @brief Wake a receiver blocked in msglanes_rec_byte_stream, which
+ * returns NULL with errcode EINTR if there is no message for it.
+ * Safe to call from a signal handler: a signal that arrives just
+ * before the receiver blocks is not lost.
+ *
+ * @param lanesp Pointer to the lane set handle.
+ */
+void msglanes_wake(MSGLANES* lanesp) {
+	sem_post(&lanesp->ctlp->doorbell);
+}
+
+/**
+ * @brief Count of messages sent but not yet received, over all lanes.
+ *
+ * @param lanesp Pointer to the lane set handle.
+ * @return Pending message count.
+ */
+int msglanes_pending(MSGLANES* lanesp) {
+	return msglanes_set_pending(lanesp->ctlp, 0) + msglanes_set_pending(lanesp->ctlp, 1);
+}
+
+/**
+ * @brief Close a lane set for draining. Called by the receiver.
+ *
+ * Further sends are refused with ESHUTDOWN. On return no send is
+ * still in progress, so msglanes_pending counts exactly the messages
+ * left to receive.
+ *
+ * @param lanesp Pointer to the lane set handle.
+ * @return The number of messages left to receive.
+ */
+int msglanes_close(MSGLANES* lanesp) {
+	lanesp->ctlp->closed = 1;
+	msglanes_wait_inflight(lanesp->ctlp);
+	return msglanes_pending(lanesp);
+}
+
+/**
+ * @brief Check whether the receiver has closed a lane set.
+ *
+ * @param lanesp Pointer to the lane set handle.
+ * @return Non-zero if closed.
+ */
+int msglanes_closed(MSGLANES* lanesp) {
+	return lanesp->ctlp->closed;
+}
+
+/**
+ * @brief Resize the lane deques of a live lane set. Called by the receiver.
+ *
+ * A new set of lane deques of the requested size is created and the
+ * epoch is bumped, which sends every sender to the new set. Messages
+ * already in the old set are received before any in the new one, so
+ * nothing is lost or reordered and senders are never refused.
+ *
+ * @param lanesp Pointer to the lane set handle.
+ * @param size New size in bytes of each lane deque.
+ * @return 0 on success, non-zero on error (see lanesp->errcode). errcode
+ * is EBUSY if the previous resize has not finished draining; try again
+ * once more messages have been received.
+ */
+int msglanes_resize(MSGLANES* lanesp, size_t size) {
+	MSGLANES_CTL* ctlp = lanesp->ctlp;
+	MSGCELL* newlanes[MSGLANES_MAX_LANES];
+	unsigned int epoch;
+
+	// The previous set may have drained with no receive since to notice.
+	msglanes_finish_resize(lanesp);
+	if (lanesp->resizing) {
+		lanesp->errcode = EBUSY;
+		return -1;
+	}
+	epoch = lanesp->epoch + 1;
+	if (msglanes_create_lanes(newlanes, lanesp->name, epoch, lanesp->mode, size, ctlp->nlanes)) {
+		lanesp->errcode = ENOMEM;
+		return -1;
+	}
+	memcpy(lanesp->old_lanes, lanesp->lanes, sizeof(lanesp->old_lanes));
+	memcpy(lanesp->lanes, newlanes, sizeof(lanesp->lanes));
+	lanesp->epoch = epoch;
+	lanesp->resizing = 1;
+
+	// Publish the new epoch, then let senders that may have read the
+	// old one finish. Their messages are counted in the old set.
+	ctlp->lane_size = size;
+	__sync_synchronize();
+	ctlp->epoch = epoch;
+	msglanes_wait_inflight(ctlp);
+	return 0;
+}
+
+/**
+ * @brief Change the starvation guard of a lane set. Called by the receiver.
+ *
+ * @param lanesp Pointer to the lane set handle.
+ * @param burst New burst (see msglanes_create).
+ */
+void msglanes_set_burst(MSGLANES* lanesp, int burst) {
+	lanesp->ctlp->burst = burst;
+}
+
+/**
+ * @brief Bound how long msglanes_rec_byte_stream waits for a message.
+ * Called by the receiver.
+ *
+ * @param lanesp Pointer to the lane set handle.
+ * @param msec Longest wait in msec, after which the receive returns
+ * NULL with errcode ETIMEDOUT. 0 waits for ever.
+ */
+void msglanes_set_timeout(MSGLANES* lanesp, int msec) {
+	lanesp->timeout = msec;
+}
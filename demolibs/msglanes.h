@@ -0,0 +1,123 @@
+/*
+ *****************************************************************
+
+<GPL>
+
+Copyright: © 2001-2015 Robert C Garvey
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+ .
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ .
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+X-Comment: On Debian systems, the complete text of the GNU General Public
+ License can be found in `/usr/share/common-licenses/GPL-3'.
+
+</GPL>
+*********************************************************************
+*/
+
+/**
+ * @file msglanes.h
+ *
+ * @brief Priority lanes layered over ulppk byte stream message deques.
+ *
+ * A lane set is a group of message deques sharing one name. Each lane
+ * is an ordinary msgdeque byte stream. A small control file next to the
+ * deques (in MMDQ_DIR_PATH) carries a doorbell semaphore and per lane
+ * pending counts, so a single receiver can block on all lanes at once
+ * and always drain the highest numbered lane first.
+ * <p>
+ * The receiver can close a lane set to drain it: senders are refused
+ * from then on, and once msglanes_close returns every accepted message
+ * is accounted for by msglanes_pending. When the receiver restarts and
+ * creates the lane set again, attached senders pick up the new lane
+ * deques on their next send, and messages the previous receiver left
+ * pending are received before any new ones.
+ * <p>
+ * The same mechanism resizes a live lane set: the receiver builds a
+ * second set of lane deques, points senders at it, and drains the old
+ * set before taking anything from the new one.
+ */
+/*
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef MSGLANES_H_
+#define MSGLANES_H_
+
+#include <semaphore.h>
+#include <sys/types.h>
+
+#include <msgdeque.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MSGLANES_MAX_LANES 4		///< Maximum number of lanes in a lane set
+#define MSGLANES_NAME_MAX 128		///< Maximum length of a lane set name
+#define MSGLANES_MAGIC 0x4d4c4e33	///< "MLN3" ... marks an initialized control file
+#define MSGLANES_SETS 2				///< Lane deque sets: current and (while resizing) previous
+#define MSGLANES_INFLIGHT_SLOTS 128	///< Senders that can be part way through a send at once
+#define MSGLANES_INFLIGHT_WAIT 5000	///< msec the receiver waits for a live sender to finish a send
+
+/**
+ * @brief Lane set control block. Lives in a memory mapped file
+ * shared by the receiver and all senders.
+ */
+typedef struct {
+	unsigned int magic;
+	int nlanes;								///< Number of lanes in use
+	int burst;								///< Starvation guard (see msglanes_create)
+	volatile unsigned int epoch;			///< Bumped each time the receiver (re)creates the lanes
+	volatile int closed;					///< Non-zero once the receiver stops accepting messages
+	volatile pid_t inflight[MSGLANES_INFLIGHT_SLOTS];	///< Pids of senders between the closed check and the doorbell (0: free)
+	volatile int rejected;					///< Sends refused because the lane set was closed
+	size_t lane_size;						///< Size in bytes of each lane deque in the current set
+	volatile int pending[MSGLANES_SETS][MSGLANES_MAX_LANES];	///< Messages sent but not yet received, by set (epoch & 1) and lane
+	sem_t doorbell;							///< Posted once per message sent on any lane
+} MSGLANES_CTL;
+
+/**
+ * @brief Process local handle on a lane set.
+ */
+typedef struct {
+	char name[MSGLANES_NAME_MAX];
+	MSGLANES_CTL* ctlp;
+	unsigned int epoch;		///< Epoch of the lane deques in lanes[]
+	MSGCELL* lanes[MSGLANES_MAX_LANES];
+	MSGCELL* old_lanes[MSGLANES_MAX_LANES];	///< Receiver only: previous set, while a resize drains it
+	int resizing;			///< Receiver only: non-zero until the previous set is drained
+	mode_t mode;			///< Receiver only: permissions for lane deques it creates
+	int streak_lane;		///< Receiver only: lane served by the current streak
+	int streak;				///< Receiver only: consecutive receives from streak_lane
+	int timeout;			///< Receiver only: msec a receive waits for a message (0: for ever)
+	int errcode;			///< errno or msgdeque error code of the last failure
+} MSGLANES;
+
+MSGLANES* msglanes_create(char* name, mode_t mode, size_t size, int nlanes, int burst);
+MSGLANES* msglanes_attach(char* name);
+int msglanes_send_byte_stream(MSGLANES* lanesp, int lane, char* buff, size_t len);
+char* msglanes_rec_byte_stream(MSGLANES* lanesp, size_t* bytes_received, int* lanep);
+void msglanes_wake(MSGLANES* lanesp);
+int msglanes_pending(MSGLANES* lanesp);
+int msglanes_close(MSGLANES* lanesp);
+int msglanes_closed(MSGLANES* lanesp);
+int msglanes_resize(MSGLANES* lanesp, size_t size);
+void msglanes_set_burst(MSGLANES* lanesp, int burst);
+void msglanes_set_timeout(MSGLANES* lanesp, int msec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MSGLANES_H_ */
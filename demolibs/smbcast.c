@@ -0,0 +1,309 @@
+/*
+ *****************************************************************
+
+<GPL>
+
+Copyright: © 2001-2015 Robert C Garvey
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+ .
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ .
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+X-Comment: On Debian systems, the complete text of the GNU General Public
+ License can be found in `/usr/share/common-licenses/GPL-3'.
+
+</GPL>
+*********************************************************************
+*/
+
+/**
+ * @file smbcast.c
+ *
+ * @brief Shared memory broadcast ring for state machine transitions.
+ *
+ * Record n lives in slot (n % capacity). The writer zeroes the slot's
+ * seq, fills the record, stores seq = n + 1 and then advances head.
+ * A reader checks seq before and after copying a slot: if either
+ * differs from cursor + 1 the writer has lapped it and the record is
+ * counted as lost. No locks are taken on either side.
+ */
+/*
+ *  Created on: Oct 19, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <ulppk_log.h>
+#include <smbcast.h>
+
+// Used when MMDQ_DIR_PATH is not in the environment. Matches the
+// mmdq_dir setting shipped in the demo ini files.
+#define SMBCAST_DEFAULT_DIR "/var/ulppk2-demo/memfiles"
+
+/*
+ * Build the path of the ring file for ring "name".
+ */
+static void smbcast_path(char* pathbuff, size_t buffsize, char* name) {
+	char* dirp;
+
+	dirp = getenv("MMDQ_DIR_PATH");
+	if (NULL == dirp) {
+		dirp = SMBCAST_DEFAULT_DIR;
+	}
+	snprintf(pathbuff, buffsize, "%s/%s.bcast", dirp, name);
+}
+
+/*
+ * Copy a name into a fixed size record field, always NUL terminated.
+ */
+static void smbcast_copy_name(char* dest, char* src) {
+	if (NULL == src) {
+		src = "";
+	}
+	strncpy(dest, src, SMBCAST_NAME_LEN - 1);
+	dest[SMBCAST_NAME_LEN - 1] = '\0';
+}
+
+/**
+ * @brief Create (or reopen) a ring as its writer.
+ *
+ * An existing ring with the same geometry keeps its head, so readers
+ * following it across a writer restart see a continuous sequence.
+ *
+ * @param name Name of the ring.
+ * @param mode Permissions for the ring file.
+ * @param capacity Number of record slots. Rounded up to a power of 2.
+ * @return Pointer to the ring handle, NULL on error.
+ */
+SMBCAST* smbcast_create(char* name, mode_t mode, uint32_t capacity) {
+	char path[512];
+	int fd;
+	uint32_t slots = 1;
+	size_t maplen;
+	void* mapp;
+	SMBCAST* bcastp;
+	SMBCAST_HDR* hdrp;
+
+	while (slots < capacity) {
+		slots <<= 1;
+	}
+	maplen = sizeof(SMBCAST_HDR) + (slots * sizeof(SMBCAST_REC));
+
+	smbcast_path(path, sizeof(path), name);
+	fd = open(path, O_RDWR | O_CREAT, mode);
+	if (fd < 0) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to open broadcast ring %s: errno = %d | %s",
+				path, errno, strerror(errno));
+		return NULL;
+	}
+	if (ftruncate(fd, maplen)) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to size broadcast ring %s: errno = %d | %s",
+				path, errno, strerror(errno));
+		close(fd);
+		return NULL;
+	}
+	mapp = mmap(NULL, maplen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (MAP_FAILED == mapp) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to map broadcast ring %s: errno = %d | %s",
+				path, errno, strerror(errno));
+		return NULL;
+	}
+
+	hdrp = (SMBCAST_HDR*)mapp;
+	if ((SMBCAST_MAGIC != hdrp->magic) || (SMBCAST_VERSION != hdrp->version) ||
+			(slots != hdrp->capacity) || (sizeof(SMBCAST_REC) != hdrp->recsize)) {
+		hdrp->magic = 0;
+		__sync_synchronize();
+		memset((char*)mapp + sizeof(SMBCAST_HDR), 0, slots * sizeof(SMBCAST_REC));
+		hdrp->version = SMBCAST_VERSION;
+		hdrp->capacity = slots;
+		hdrp->recsize = sizeof(SMBCAST_REC);
+		hdrp->head = 0;
+		__sync_synchronize();
+		hdrp->magic = SMBCAST_MAGIC;
+	}
+
+	bcastp = calloc(1, sizeof(SMBCAST));
+	bcastp->hdrp = hdrp;
+	bcastp->recs = (SMBCAST_REC*)((char*)mapp + sizeof(SMBCAST_HDR));
+	bcastp->maplen = maplen;
+	bcastp->capacity = slots;
+	return bcastp;
+}
+
+/**
+ * @brief Publish one transition. Writer only; never blocks.
+ *
+ * @param bcastp Pointer to the ring handle.
+ * @param old_state State before the transition.
+ * @param new_state State after the transition.
+ * @param event Event that caused it.
+ * @param serialnumber Serial number carried by the event.
+ * @return 0 on success.
+ */
+int smbcast_publish(SMBCAST* bcastp, char* old_state, char* new_state, char* event, uint64_t serialnumber) {
+	SMBCAST_HDR* hdrp = bcastp->hdrp;
+	SMBCAST_REC* recp;
+	uint64_t seq;
+	struct timespec now;
+
+	seq = hdrp->head;
+	recp = &bcastp->recs[seq & (bcastp->capacity - 1)];
+
+	// Mark the slot as being rewritten before touching it.
+	recp->seq = 0;
+	__sync_synchronize();
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	recp->serialnumber = serialnumber;
+	recp->tv_sec = now.tv_sec;
+	recp->tv_nsec = now.tv_nsec;
+	smbcast_copy_name(recp->old_state, old_state);
+	smbcast_copy_name(recp->new_state, new_state);
+	smbcast_copy_name(recp->event, event);
+
+	__sync_synchronize();
+	recp->seq = seq + 1;
+	__sync_synchronize();
+	hdrp->head = seq + 1;
+	return 0;
+}
+
+/**
+ * @brief Open a ring as a reader. The ring must already exist.
+ *
+ * @param name Name of the ring.
+ * @param from_oldest Non-zero to start at the oldest record still in
+ * the ring, zero to start with the next record published.
+ * @return Pointer to the ring handle, NULL on error.
+ */
+SMBCAST* smbcast_open_reader(char* name, int from_oldest) {
+	char path[512];
+	int fd;
+	struct stat sb;
+	void* mapp;
+	SMBCAST* bcastp;
+	SMBCAST_HDR* hdrp;
+	uint64_t head;
+
+	smbcast_path(path, sizeof(path), name);
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to open broadcast ring %s: errno = %d | %s",
+				path, errno, strerror(errno));
+		return NULL;
+	}
+	if (fstat(fd, &sb) || (sb.st_size < (off_t)sizeof(SMBCAST_HDR))) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Broadcast ring %s is not initialized", path);
+		close(fd);
+		return NULL;
+	}
+	mapp = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (MAP_FAILED == mapp) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to map broadcast ring %s: errno = %d | %s",
+				path, errno, strerror(errno));
+		return NULL;
+	}
+	hdrp = (SMBCAST_HDR*)mapp;
+	if ((SMBCAST_MAGIC != hdrp->magic) || (SMBCAST_VERSION != hdrp->version) ||
+			(sizeof(SMBCAST_REC) != hdrp->recsize) ||
+			(sb.st_size < (off_t)(sizeof(SMBCAST_HDR) + (hdrp->capacity * sizeof(SMBCAST_REC))))) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Broadcast ring %s has an unexpected format", path);
+		munmap(mapp, sb.st_size);
+		return NULL;
+	}
+
+	bcastp = calloc(1, sizeof(SMBCAST));
+	bcastp->hdrp = hdrp;
+	bcastp->recs = (SMBCAST_REC*)((char*)mapp + sizeof(SMBCAST_HDR));
+	bcastp->maplen = sb.st_size;
+	bcastp->capacity = hdrp->capacity;
+	head = hdrp->head;
+	if (from_oldest) {
+		bcastp->cursor = (head > bcastp->capacity) ? (head - bcastp->capacity) : 0;
+	} else {
+		bcastp->cursor = head;
+	}
+	return bcastp;
+}
+
+/**
+ * @brief Read the next record at the reader's cursor. Never blocks;
+ * poll again later if nothing is available.
+ *
+ * @param bcastp Pointer to the ring handle.
+ * @param recp Receives a copy of the record.
+ * @return 1 if a record was read, 0 if the reader is caught up, -1 if
+ * the writer recreated the ring with a different size (or is part way
+ * through doing so): close it and open it again.
+ * bcastp->lost counts records the writer overwrote before they were read.
+ */
+int smbcast_read(SMBCAST* bcastp, SMBCAST_REC* recp) {
+	SMBCAST_HDR* hdrp = bcastp->hdrp;
+	SMBCAST_REC* slotp;
+	uint64_t head;
+	uint64_t before;
+
+	for (;;) {
+		// Our mapping only covers the slots the ring had when we opened it.
+		if ((SMBCAST_MAGIC != hdrp->magic) || (bcastp->capacity != hdrp->capacity)) {
+			return -1;
+		}
+		head = hdrp->head;
+		__sync_synchronize();
+		if (bcastp->cursor >= head) {
+			if (bcastp->cursor > head) {
+				// The writer started over with a fresh ring.
+				bcastp->cursor = head;
+			}
+			return 0;
+		}
+		if ((head - bcastp->cursor) > bcastp->capacity) {
+			bcastp->lost += (head - bcastp->capacity) - bcastp->cursor;
+			bcastp->cursor = head - bcastp->capacity;
+		}
+
+		slotp = &bcastp->recs[bcastp->cursor & (bcastp->capacity - 1)];
+		before = slotp->seq;
+		__sync_synchronize();
+		memcpy(recp, (void*)slotp, sizeof(SMBCAST_REC));
+		__sync_synchronize();
+		if ((before == bcastp->cursor + 1) && (slotp->seq == before)) {
+			bcastp->cursor++;
+			return 1;
+		}
+
+		// Lapped while copying. This record is gone; try the next.
+		bcastp->lost++;
+		bcastp->cursor++;
+	}
+}
+
+/**
+ * @brief Unmap a ring and free the handle.
+ *
+ * @param bcastp Pointer to the ring handle.
+ */
+void smbcast_close(SMBCAST* bcastp) {
+	munmap(bcastp->hdrp, bcastp->maplen);
+	free(bcastp);
+}
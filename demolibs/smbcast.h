@@ -0,0 +1,105 @@
+/*
+ *****************************************************************
+
+<GPL>
+
+Copyright: © 2001-2015 Robert C Garvey
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+ .
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ .
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+X-Comment: On Debian systems, the complete text of the GNU General Public
+ License can be found in `/usr/share/common-licenses/GPL-3'.
+
+</GPL>
+*********************************************************************
+*/
+
+/**
+ * @file smbcast.h
+ *
+ * @brief Shared memory broadcast ring for state machine transitions.
+ *
+ * One writer publishes fixed size transition records into a memory
+ * mapped ring file in MMDQ_DIR_PATH. Any number of readers map the
+ * same file and follow it with their own cursor. Readers never write
+ * to the ring, so a slow or dead reader can't hold up the writer; a
+ * reader that falls more than a ring's worth behind skips ahead and
+ * is told how many records it lost.
+ */
+/*
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef SMBCAST_H_
+#define SMBCAST_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SMBCAST_MAGIC 0x534d4243	///< "SMBC" ... marks an initialized ring
+#define SMBCAST_VERSION 1
+#define SMBCAST_NAME_LEN 32			///< Room for a state or event name, including the NUL
+
+/**
+ * @brief One published transition. 128 bytes.
+ */
+typedef struct {
+	volatile uint64_t seq;			///< Sequence number + 1 once the slot is complete, 0 while being written
+	uint64_t serialnumber;			///< Serial number carried by the event (0 if none)
+	int64_t tv_sec;					///< Time of the transition (CLOCK_REALTIME)
+	int64_t tv_nsec;
+	char old_state[SMBCAST_NAME_LEN];
+	char new_state[SMBCAST_NAME_LEN];
+	char event[SMBCAST_NAME_LEN];
+} SMBCAST_REC;
+
+/**
+ * @brief Ring header at the start of the file. The records follow it.
+ */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t capacity;				///< Number of record slots (a power of 2)
+	uint32_t recsize;				///< sizeof(SMBCAST_REC) of the writer
+	volatile uint64_t head;			///< Sequence number of the next record to publish
+	char pad[40];
+} SMBCAST_HDR;
+
+/**
+ * @brief Process local handle on a ring, for the writer or one reader.
+ */
+typedef struct {
+	SMBCAST_HDR* hdrp;
+	SMBCAST_REC* recs;
+	size_t maplen;
+	uint32_t capacity;				///< Number of record slots when the ring was mapped
+	uint64_t cursor;				///< Reader only: sequence number of the next record to read
+	uint64_t lost;					///< Reader only: records overwritten before they could be read
+} SMBCAST;
+
+SMBCAST* smbcast_create(char* name, mode_t mode, uint32_t capacity);
+int smbcast_publish(SMBCAST* bcastp, char* old_state, char* new_state, char* event, uint64_t serialnumber);
+SMBCAST* smbcast_open_reader(char* name, int from_oldest);
+int smbcast_read(SMBCAST* bcastp, SMBCAST_REC* recp);
+void smbcast_close(SMBCAST* bcastp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SMBCAST_H_ */
@@ -0,0 +1,313 @@
+/*
+ *****************************************************************
+
+<GPL>
+
+Copyright: © 2001-2015 Robert C Garvey
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+ .
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ .
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+X-Comment: On Debian systems, the complete text of the GNU General Public
+ License can be found in `/usr/share/common-licenses/GPL-3'.
+
+</GPL>
+*********************************************************************
+*/
+
+/**
+ * @file demomachine.c
+ *
+ * @brief The demo state machine: events, states, transitions and
+ * action handlers.
+ *
+ * demoserver feeds it events from its input deque; demoreplay feeds
+ * it captured event streams for benchmarking. Both get the same
+ * machine from demo_machine_init().
+ * <p>
+ * One sm_transition call can take several transitions, since an
+ * action handler may return an event of its own (see
+ * demo_actionhandler3). So that each of them can be reported, every
+ * transition runs its own action list: a recorder that calls
+ * demo_tx_hook with the transition, then the actions of the action
+ * list the transition is drawn with.
+ */
+/*
+ *  Created on: Oct 19, 2026
+ */
+
+#include <stdio.h>
+
+#include <statemachine.h>
+
+#include "demomachine.h"
+
+FILE* fdemolog;
+DEMO_TX_HOOK demo_tx_hook = NULL;
+
+// Declare the machine. We could allocate space
+// from the heap but this makes debugging easier.
+SM_MACHINE sm_machine;
+
+// Declare the state table.
+SM_STATE_TABLE_DEF state_table;
+
+// event names. Define using the SMDEFNAME macro
+SMDEFNAME(DEMO_EVENT1)
+SMDEFNAME(DEMO_EVENT2)
+SMDEFNAME(DEMO_EVENT3)
+SMDEFNAME(DEMO_EVENT4)
+
+// Action list names, one per transition.
+SMDEFNAME(DEMO_ALTX1)
+SMDEFNAME(DEMO_ALTX2)
+SMDEFNAME(DEMO_ALTX3)
+SMDEFNAME(DEMO_ALTX4)
+SMDEFNAME(DEMO_ALTX5)
+SMDEFNAME(DEMO_ALTX6)
+SMDEFNAME(DEMO_ALTX7)
+SMDEFNAME(DEMO_ALTXSHUTDOWN)
+
+// Action handler names
+SMDEFNAME(DEMO_AH1)
+SMDEFNAME(DEMO_AH2)
+SMDEFNAME(DEMO_AH3)
+SMDEFNAME(DEMO_AHSHUTDOWN)
+SMDEFNAME(DEMO_AHRECORD)
+
+// State names
+SMDEFNAME(DEMO_STATE1)
+SMDEFNAME(DEMO_STATE2)
+SMDEFNAME(DEMO_STATE3)
+SMDEFNAME(DEMO_STATE_TERMINATED)
+
+// Transition names
+SMDEFNAME(DEMO_TX1)
+SMDEFNAME(DEMO_TX2)
+SMDEFNAME(DEMO_TX3)
+
+// Forward declarations for state machine action handlers
+SM_EVENT_HANDLE demo_actionhandler1(SM_MACHINE* machinep, void* datap);
+SM_EVENT_HANDLE demo_actionhandler2(SM_MACHINE* machinep, void* datap);
+SM_EVENT_HANDLE demo_actionhandler3(SM_MACHINE* machinep, void* datap);
+SM_EVENT_HANDLE demo_actionhandler_shutdown(SM_MACHINE* machinep, void* datap);
+
+typedef SM_EVENT_HANDLE (*DEMO_HANDLER)(SM_MACHINE* machinep, void* datap);
+
+/**
+ * @brief One action of an action list.
+ */
+typedef struct {
+	char** namep;			///< Action handler name
+	DEMO_HANDLER handler;
+} DEMO_ACTION;
+
+// The ward/mellor action lists. Each ends with a NULL entry.
+static DEMO_ACTION demo_al1[] = {			// Just calls demo_actionhandler1
+	{ &DEMO_AH1, demo_actionhandler1 },
+	{ NULL, NULL }
+};
+static DEMO_ACTION demo_al2[] = {			// Calls demo_actionhandler_2 and 3
+	{ &DEMO_AH2, demo_actionhandler2 },
+	{ &DEMO_AH3, demo_actionhandler3 },
+	{ NULL, NULL }
+};
+static DEMO_ACTION demo_al3[] = {			// Just calls demo_actionhandler3
+	{ &DEMO_AH3, demo_actionhandler3 },
+	{ NULL, NULL }
+};
+static DEMO_ACTION demo_alshutdown[] = {	// Used by the "global transition" for shutdown
+	{ &DEMO_AHSHUTDOWN, demo_actionhandler_shutdown },
+	{ NULL, NULL }
+};
+
+/**
+ * @brief One transition of the machine.
+ */
+typedef struct {
+	char** alp;				///< The transition's own action list
+	char** fromp;			///< NULL for the global transition
+	char** top;
+	char** eventp;
+	DEMO_ACTION* actions;	///< Actions run after the recorder
+} DEMO_TX;
+
+static DEMO_TX demo_tx[] = {
+	{ &DEMO_ALTX1, &DEMO_STATE1, &DEMO_STATE2, &DEMO_EVENT1, demo_al1 },
+	{ &DEMO_ALTX2, &DEMO_STATE1, &DEMO_STATE3, &DEMO_EVENT3, demo_al2 },
+	{ &DEMO_ALTX3, &DEMO_STATE2, &DEMO_STATE1, &DEMO_EVENT2, demo_al2 },
+	{ &DEMO_ALTX4, &DEMO_STATE2, &DEMO_STATE3, &DEMO_EVENT1, demo_al1 },
+	{ &DEMO_ALTX5, &DEMO_STATE3, &DEMO_STATE1, &DEMO_EVENT1, demo_al1 },
+	{ &DEMO_ALTX6, &DEMO_STATE3, &DEMO_STATE2, &DEMO_EVENT3, demo_al3 },
+	{ &DEMO_ALTX7, &DEMO_STATE3, &DEMO_STATE2, &DEMO_EVENT2, demo_al2 },
+
+	// here's a global transition. When DEMO_EVENT4 is detected from any state, transition
+	// to shut down and transition to state DEMO_TERMINATED (dead) state.
+	{ &DEMO_ALTXSHUTDOWN, NULL, &DEMO_STATE_TERMINATED, &DEMO_EVENT4, demo_alshutdown }
+};
+
+#define DEMO_NTX ((int)(sizeof(demo_tx) / sizeof(demo_tx[0])))
+
+/**
+ * @brief Report transition n through demo_tx_hook. Runs first in the
+ * transition's action list, so the current state is still the state
+ * the transition leaves.
+ */
+static void demo_record_tx(SM_MACHINE* machinep, int n) {
+	if (NULL != demo_tx_hook) {
+		demo_tx_hook((NULL == demo_tx[n].fromp) ? sm_curr_state(machinep) : *demo_tx[n].fromp,
+				*demo_tx[n].eventp, *demo_tx[n].top);
+	}
+}
+
+// Action handlers can't tell which transition they run for, so
+// each transition has a recorder of its own.
+#define DEMO_TX_RECORDER(n) \
+	static SM_EVENT_HANDLE demo_tx_recorder##n(SM_MACHINE* machinep, void* datap) { \
+		demo_record_tx(machinep, n); \
+		return EV_NULL_HANDLE; \
+	}
+
+DEMO_TX_RECORDER(0)
+DEMO_TX_RECORDER(1)
+DEMO_TX_RECORDER(2)
+DEMO_TX_RECORDER(3)
+DEMO_TX_RECORDER(4)
+DEMO_TX_RECORDER(5)
+DEMO_TX_RECORDER(6)
+DEMO_TX_RECORDER(7)
+
+// One per demo_tx entry, in the same order.
+static DEMO_HANDLER demo_tx_recorders[] = {
+	demo_tx_recorder0, demo_tx_recorder1, demo_tx_recorder2, demo_tx_recorder3,
+	demo_tx_recorder4, demo_tx_recorder5, demo_tx_recorder6, demo_tx_recorder7
+};
+
+// Fails to compile (negative array size) if a transition is added to
+// demo_tx without a DEMO_TX_RECORDER and demo_tx_recorders entry.
+typedef char demo_tx_recorders_match[(DEMO_NTX == (int)(sizeof(demo_tx_recorders) / sizeof(demo_tx_recorders[0]))) ? 1 : -1];
+
+/**
+ * @brief Action handler 1 will return EV_NULL_HANDLE, the null
+ * event. No transition will be triggered.
+ *
+ * @param machinep Pointer to state machine data structure
+ * @param datap Pointer to data transmitted by the URL encoded event (the message)
+ * @return The event EV_NULL_HANDLE
+ */
+SM_EVENT_HANDLE demo_actionhandler1(SM_MACHINE* machinep, void* datap) {
+	fprintf(fdemolog, "ActionHandler1: from state: %s message [%s] return EV_NULL\n", sm_curr_state(machinep), (char*)datap);
+	return EV_NULL_HANDLE;
+}
+
+/**
+ * @brief Action handler 2 will return EV_NULL_HANDLE, the null
+ * event. No transition will be triggered.
+ *
+ * @param machinep Pointer to state machine data structure
+ * @param datap Pointer to data transmitted by the URL encoded event (the message)
+ * @return The event EV_NULL_HANDLE
+ */
+
+SM_EVENT_HANDLE demo_actionhandler2(SM_MACHINE* machinep, void* datap) {
+	fprintf(fdemolog, "ActionHandler2: from state: %s message [%s] return EV_NULL\n", sm_curr_state(machinep), (char*)datap);
+	return EV_NULL_HANDLE;
+}
+
+/**
+ * @brief Action handler 3 will return DEMO_EVENT2, which should force
+ * a transition from DEMO_STATE2 to DEMO_STATE1
+ *
+ * @param machinep Pointer to state machine data structure
+ * @param datap Pointer to data transmitted by the URL encoded event (the message)
+ * @return The event DEMO_EVENT2
+ */
+SM_EVENT_HANDLE demo_actionhandler3(SM_MACHINE* machinep, void* datap) {
+	fprintf(fdemolog, "ActionHandler3: from state: %s message: [%s] return event DEMO_EVENT2\n", sm_curr_state(machinep), (char*)datap);
+	return sm_event_handle(machinep, DEMO_EVENT2);
+}
+
+/**
+ * @brief Shutdown action handler. By the time the global shutdown
+ * transition runs, demoserver() has already drained the input deque.
+ *
+ * @param machinep Pointer to state machine data structure
+ * @param datap Pointer to data transmitted by the URL encoded event (the message)
+ * @return The event EV_NULL_HANDLE
+ */
+SM_EVENT_HANDLE demo_actionhandler_shutdown(SM_MACHINE* machinep, void* datap) {
+	fprintf(fdemolog, "ActionHandler SHUTDOWN ... exiting the demoserver from state %s\n", sm_curr_state(machinep));
+	return EV_NULL_HANDLE;
+}
+
+/**
+ * @brief Statemachine initialization.
+ *
+ * Defines the simple demo state machine. Action handlers write to
+ * fdemolog, which defaults to stdout if the caller hasn't set it.
+ *
+ * @return Pointer to the completed state machine.
+ */
+SM_MACHINE* demo_machine_init() {
+	SM_MACHINE* machinep;
+	DEMO_ACTION* actionp;
+	int n;
+
+	// Set our output stream
+	if (NULL == fdemolog) {
+		fdemolog = stdout;
+	}
+
+	// Get a new state machine
+	machinep = sm_new_machine(&sm_machine, &state_table, "demomachine");
+
+	// Register stock events and definitions
+	sm_register_stock_defs(machinep);
+
+	// Define the events.
+	sm_register_event(machinep, DEMO_EVENT1);
+	sm_register_event(machinep, DEMO_EVENT2);
+	sm_register_event(machinep, DEMO_EVENT3);
+	sm_register_event(machinep, DEMO_EVENT4);
+
+	// Define the action lists, one per transition, and register the
+	// action handlers: the transition's recorder first, then the
+	// actions of its ward/mellor action list.
+	for (n = 0; n < DEMO_NTX; n++) {
+		sm_register_action_list(machinep, *demo_tx[n].alp);
+		sm_register_action(machinep, *demo_tx[n].alp, DEMO_AHRECORD, demo_tx_recorders[n]);
+		for (actionp = demo_tx[n].actions; NULL != actionp->namep; actionp++) {
+			sm_register_action(machinep, *demo_tx[n].alp, *actionp->namep, actionp->handler);
+		}
+	}
+
+	// Define the machine states
+	sm_register_state(machinep, DEMO_STATE1);
+	sm_register_state(machinep, DEMO_STATE2);
+	sm_register_state(machinep, DEMO_STATE3);
+	sm_register_state(machinep, DEMO_STATE_TERMINATED);
+
+	// Now register the state transitions (and the global one)
+	for (n = 0; n < DEMO_NTX; n++) {
+		if (NULL == demo_tx[n].fromp) {
+			sm_register_global_transition(machinep, *demo_tx[n].top, *demo_tx[n].eventp, *demo_tx[n].alp);
+		} else {
+			sm_register_transition(machinep, *demo_tx[n].fromp, *demo_tx[n].top, *demo_tx[n].eventp,
+					*demo_tx[n].alp);
+		}
+	}
+
+	// Mark the state machine definition as being complete
+	sm_set_definition_complete(machinep);
+	return machinep;
+}
@@ -0,0 +1,67 @@
+/*
+ *****************************************************************
+
+<GPL>
+
+Copyright: © 2001-2015 Robert C Garvey
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+ .
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ .
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+X-Comment: On Debian systems, the complete text of the GNU General Public
+ License can be found in `/usr/share/common-licenses/GPL-3'.
+
+</GPL>
+*********************************************************************
+*/
+
+/**
+ * @file demomachine.h
+ *
+ * @brief The demo state machine definition, shared by demoserver
+ * and demoreplay.
+ */
+/*
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef DEMOMACHINE_H_
+#define DEMOMACHINE_H_
+
+#include <stdio.h>
+
+#include <statemachine.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The event that triggers the global shutdown transition.
+#define DEMO_SHUTDOWN_EVENT "DEMO_EVENT4"
+
+// Output stream for the action handlers.
+extern FILE* fdemolog;
+
+// Called as each transition starts, including transitions taken on
+// events that action handlers return, so a single sm_transition call
+// may report several. NULL: not reported.
+typedef void (*DEMO_TX_HOOK)(char* from, char* event, char* to);
+extern DEMO_TX_HOOK demo_tx_hook;
+
+SM_MACHINE* demo_machine_init();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEMOMACHINE_H_ */
@@ -0,0 +1,304 @@
+/*
+ *****************************************************************
+
+<GPL>
+
+Copyright: © 2001-2015 Robert C Garvey
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+ .
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ .
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+X-Comment: On Debian systems, the complete text of the GNU General Public
+ License can be found in `/usr/share/common-licenses/GPL-3'.
+
+</GPL>
+*********************************************************************
+*/
+
+/**
+ * @file demoquery.c
+ *
+ * @brief Counts (or lists) archived demoserver events matching a
+ * filter, e.g. how many DEMO_EVENT3 events were taken from DEMO_STATE1
+ * in the last hour:
+ * <p>
+ * demoquery -e DEMO_EVENT3 -o DEMO_STATE1 -s 3600
+ * <p>
+ * The archive (see evarchive.h) is only mapped read only, so queries
+ * never touch demoserver. Blocks are passed over on their index record
+ * (time and serial number range) or their name dictionary wherever
+ * possible, and only the columns a filter needs are inflated.
+ *
+ * Command line arguments and switches:
+ * <ol>
+ * <li>-h --- help</li>
+ * <li>-d < directory > archive directory (default data_dir from demoserver.ini)</li>
+ * <li>-e < event > only this event</li>
+ * <li>-o < state > only events taken from this state</li>
+ * <li>-n < state > only events leading to this state</li>
+ * <li>-s < seconds > only events in the last so many seconds</li>
+ * <li>-m < serial > only serial numbers from this one on</li>
+ * <li>-x < serial > only serial numbers up to this one</li>
+ * <li>-p --- print the matching events</li>
+ * <li>-v --- report blocks skipped and scan rate</li>
+ * </ol>
+ */
+/*
+ *  Created on: Oct 19, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <cmdargs.h>
+#include <democonfig.h>
+#include <evarchive.h>
+
+/**
+ * @brief The query, from the command line.
+ */
+typedef struct {
+	char* names[EVARCH_NCOLS];	///< Name filter per name column (NULL: any)
+	int64_t since;				///< Earliest time, nsec since the epoch (0: any)
+	int have_min_serial;
+	uint64_t min_serial;
+	int have_max_serial;
+	uint64_t max_serial;
+	int print;
+} QUERY;
+
+/**
+ * @brief Query statistics.
+ */
+typedef struct {
+	unsigned long matched;
+	unsigned long scanned;			///< Events in the blocks read
+	unsigned long blocks_read;
+	unsigned long blocks_skipped;	///< On the index or dictionary
+	unsigned long blocks_bad;
+} QUERY_STATS;
+
+// Column buffers for one block
+static int64_t times[EVARCH_BLOCK_EVENTS];
+static uint64_t serials[EVARCH_BLOCK_EVENTS];
+static uint8_t codes[EVARCH_NCOLS][EVARCH_BLOCK_EVENTS];
+
+/**
+ * @brief Command argument registration/definition
+ *
+ * @return Returns non-zero on error.
+ */
+static int register_cmdline() {
+	int status = 0;
+
+	status |= cmdarg_register_option("h", "help", CA_SWITCH, "Get help on this program", NULL, NULL);
+	status |= cmdarg_register_option("d", "dir", CA_DEFAULT_ARG,
+			"Archive directory (default is data_dir from demoserver.ini)", "", "h");
+	status |= cmdarg_register_option("e", "event", CA_DEFAULT_ARG, "Only this event", "", "h");
+	status |= cmdarg_register_option("o", "from", CA_DEFAULT_ARG, "Only events taken from this state", "", "h");
+	status |= cmdarg_register_option("n", "to", CA_DEFAULT_ARG, "Only events leading to this state", "", "h");
+	status |= cmdarg_register_option("s", "since", CA_DEFAULT_ARG,
+			"Only events in the last so many seconds (default is all)", "0", "h");
+	status |= cmdarg_register_option("m", "min-serial", CA_DEFAULT_ARG, "Only serial numbers from this one on", "", "h");
+	status |= cmdarg_register_option("x", "max-serial", CA_DEFAULT_ARG, "Only serial numbers up to this one", "", "h");
+	status |= cmdarg_register_option("p", "print", CA_SWITCH, "Print the matching events", NULL, "h");
+	status |= cmdarg_register_option("v", "verbose", CA_SWITCH, "Report blocks skipped and scan rate", NULL, "h");
+	return status;
+}
+
+/**
+ * @brief Fetch an optional string argument.
+ *
+ * @return Heap copy of the argument, NULL if it was not given.
+ */
+static char* fetch_optional(char* key) {
+	char buff[256];
+
+	cmdarg_load_string(buff, sizeof(buff), NULL, key);
+	return ('\0' == buff[0]) ? NULL : strdup(buff);
+}
+
+/**
+ * @brief Run the query over one block.
+ *
+ * @return Non-zero if the block could not be read.
+ */
+static int query_block(EVARCH_READER* readerp, uint32_t blockno, QUERY* queryp, QUERY_STATS* statsp) {
+	EVARCH_INDEX* idxp = &readerp->index[blockno];
+	EVARCH_BLOCKHDR* blockp;
+	int want[EVARCH_NCOLS];
+	int need_time;
+	int need_serial;
+	int col;
+	int count;
+	int i;
+
+	// Whole block outside the time or serial number range?
+	if (((queryp->since > 0) && (idxp->max_ts < queryp->since)) ||
+			(queryp->have_min_serial && (idxp->max_serial < queryp->min_serial)) ||
+			(queryp->have_max_serial && (idxp->min_serial > queryp->max_serial))) {
+		statsp->blocks_skipped++;
+		return 0;
+	}
+
+	blockp = evarch_block(readerp, blockno);
+	if (NULL == blockp) {
+		return -1;
+	}
+
+	// A name the block's dictionary doesn't have can't match.
+	for (col = EVARCH_COL_OLD; col < EVARCH_NCOLS; col++) {
+		want[col] = -1;
+		if (NULL == queryp->names[col]) {
+			continue;
+		}
+		want[col] = evarch_dict_code(blockp, queryp->names[col]);
+		if (want[col] < 0) {
+			statsp->blocks_skipped++;
+			return 0;
+		}
+	}
+
+	// Range checks are only needed if the block straddles the range.
+	need_time = queryp->print || ((queryp->since > 0) && (idxp->min_ts < queryp->since));
+	need_serial = queryp->print || (queryp->have_min_serial && (idxp->min_serial < queryp->min_serial)) ||
+			(queryp->have_max_serial && (idxp->max_serial > queryp->max_serial));
+
+	count = blockp->count;
+	if ((need_time && (evarch_read_column(readerp, blockno, EVARCH_COL_TIME, times) != count)) ||
+			(need_serial && (evarch_read_column(readerp, blockno, EVARCH_COL_SERIAL, serials) != count))) {
+		return -1;
+	}
+	for (col = EVARCH_COL_OLD; col < EVARCH_NCOLS; col++) {
+		if (((want[col] >= 0) || queryp->print) &&
+				(evarch_read_column(readerp, blockno, col, codes[col]) != count)) {
+			return -1;
+		}
+	}
+	statsp->blocks_read++;
+	statsp->scanned += count;
+
+	// No per event test left to do: every event in the block matches.
+	if (!need_time && !need_serial && (want[EVARCH_COL_OLD] < 0) && (want[EVARCH_COL_NEW] < 0) &&
+			(want[EVARCH_COL_EVENT] < 0)) {
+		statsp->matched += count;
+		return 0;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (((want[EVARCH_COL_EVENT] >= 0) && (codes[EVARCH_COL_EVENT][i] != want[EVARCH_COL_EVENT])) ||
+				((want[EVARCH_COL_OLD] >= 0) && (codes[EVARCH_COL_OLD][i] != want[EVARCH_COL_OLD])) ||
+				((want[EVARCH_COL_NEW] >= 0) && (codes[EVARCH_COL_NEW][i] != want[EVARCH_COL_NEW])) ||
+				(need_time && (times[i] < queryp->since)) ||
+				(need_serial && queryp->have_min_serial && (serials[i] < queryp->min_serial)) ||
+				(need_serial && queryp->have_max_serial && (serials[i] > queryp->max_serial))) {
+			continue;
+		}
+		statsp->matched++;
+		if (queryp->print) {
+			fprintf(stdout, "%lld.%06ld serial %llu: %s --%s--> %s\n",
+					(long long)(times[i] / 1000000000LL), (long)((times[i] % 1000000000LL) / 1000),
+					(unsigned long long)serials[i],
+					evarch_dict_name(blockp, codes[EVARCH_COL_OLD][i]),
+					evarch_dict_name(blockp, codes[EVARCH_COL_EVENT][i]),
+					evarch_dict_name(blockp, codes[EVARCH_COL_NEW][i]));
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Main program
+ *
+ */
+int main(int argc, char* argv[]) {
+	char dir[512];
+	char* serialp;
+	int seconds;
+	QUERY query;
+	QUERY_STATS stats;
+	EVARCH_READER* readerp;
+	struct timespec start;
+	struct timespec end;
+	double elapsed;
+	uint32_t blockno;
+
+	cmdarg_init(argc, argv);
+	if (register_cmdline()) {
+		fprintf(stderr, "Registration error was reported!\n");
+	}
+	if (cmdarg_parse(argc, argv) || cmdarg_fetch_switch(NULL, "h")) {
+		cmdarg_show_help(NULL);
+		return 1;
+	}
+
+	memset(&query, 0, sizeof(query));
+	memset(&stats, 0, sizeof(stats));
+	query.names[EVARCH_COL_EVENT] = fetch_optional("e");
+	query.names[EVARCH_COL_OLD] = fetch_optional("o");
+	query.names[EVARCH_COL_NEW] = fetch_optional("n");
+	query.print = cmdarg_fetch_switch(NULL, "p");
+	seconds = cmdarg_fetch_int(NULL, "s");
+	clock_gettime(CLOCK_REALTIME, &start);
+	if (seconds > 0) {
+		query.since = ((int64_t)(start.tv_sec - seconds) * 1000000000LL) + start.tv_nsec;
+	}
+	if (NULL != (serialp = fetch_optional("m"))) {
+		query.have_min_serial = 1;
+		query.min_serial = strtoull(serialp, NULL, 10);
+	}
+	if (NULL != (serialp = fetch_optional("x"))) {
+		query.have_max_serial = 1;
+		query.max_serial = strtoull(serialp, NULL, 10);
+	}
+
+	// Same place demoserver writes it, unless told otherwise.
+	cmdarg_load_string(dir, sizeof(dir), NULL, "d");
+	if ('\0' == dir[0]) {
+		democonfig_load("demoserver");
+		snprintf(dir, sizeof(dir), "%s", democonfig_get_string("environment", "data_dir", DEMO_DATA_DIR));
+	}
+
+	readerp = evarch_open_reader(dir, DEMO_EVENT_ARCHIVE);
+	if (NULL == readerp) {
+		fprintf(stderr, "Unable to open event archive %s/%s ... has demoserver run with archive = 1?\n",
+				dir, DEMO_EVENT_ARCHIVE);
+		return 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (blockno = 0; blockno < readerp->nblocks; blockno++) {
+		if (query_block(readerp, blockno, &query, &stats)) {
+			stats.blocks_bad++;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	elapsed = (end.tv_sec - start.tv_sec) + ((end.tv_nsec - start.tv_nsec) / 1e9);
+
+	fprintf(stdout, "%lu\n", stats.matched);
+	if (cmdarg_fetch_switch(NULL, "v")) {
+		fprintf(stderr, "%u blocks: %lu read, %lu skipped, %lu unreadable; %lu events scanned in %.6f sec",
+				readerp->nblocks, stats.blocks_read, stats.blocks_skipped, stats.blocks_bad, stats.scanned, elapsed);
+		if (elapsed > 0) {
+			fprintf(stderr, " (%.0f events/sec)", stats.scanned / elapsed);
+		}
+		fprintf(stderr, "\n");
+	}
+	if (stats.blocks_bad > 0) {
+		fprintf(stderr, "%lu corrupt blocks were left out of the count\n", stats.blocks_bad);
+	}
+	evarch_close_reader(readerp);
+	return 0;
+}
@@ -0,0 +1,431 @@
+/*
+ *****************************************************************
+
+<GPL>
+
+Copyright: © 2001-2015 Robert C Garvey
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+ .
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ .
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+X-Comment: On Debian systems, the complete text of the GNU General Public
+ License can be found in `/usr/share/common-licenses/GPL-3'.
+
+</GPL>
+*********************************************************************
+*/
+
+/**
+ * @file demoreplay.c
+ *
+ * @brief Replays captured event streams through the demo state machine
+ * and reports its throughput and per-transition latency.
+ *
+ * The input is the line log written by demosocketserver ("LINE: ..."),
+ * or by demoserver ("LINE [bytes = n]: ..."), or bare URL encoded event
+ * lines. Sockets and deques are bypassed entirely: every line is
+ * decoded up front and then pushed into the machine built by
+ * demo_machine_init(), the same one demoserver runs.
+ * <p>
+ * A line may be prefixed by an epoch timestamp in seconds (for example
+ * by piping demosocketserver through "ts %.s"). With -t, those
+ * timestamps set the replay pace; otherwise events are replayed as
+ * fast as the machine takes them.
+ * <p>
+ * Latency is reported per transition: an event whose action handlers
+ * return further events is split into the transitions it causes (see
+ * demo_tx_hook). An event that takes no transition is reported with
+ * the same from and to state.
+ * <p>
+ * Shutdown events (DEMO_EVENT4) are skipped so the machine is never
+ * terminated part way through a run.
+ *
+ * Command line arguments and switches:
+ * <ol>
+ * <li>-h --- help</li>
+ * <li>-f < capture file > events to replay (required)</li>
+ * <li>-n < count > number of passes over the capture (default 1)</li>
+ * <li>-t --- replay at the recorded timing</li>
+ * <li>-v --- show action handler output (discarded by default)</li>
+ * </ol>
+ */
+/*
+ *  Created on: Oct 19, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <cmdargs.h>
+#include <statemachine.h>
+#include <urlcoder.h>
+
+#include "demomachine.h"
+
+#define REPLAY_MAX_TX 128		// distinct (state, event, new state) triples tracked
+#define REPLAY_NAME_LEN 48
+
+/**
+ * @brief One decoded event from the capture.
+ */
+typedef struct {
+	double timestamp;		///< Recorded time (epoch seconds), 0 if the line had none
+	char* event;
+	char* message;
+	PLL_HEAD arglistp;		///< Decoded arguments. event and message point into it.
+} REPLAY_EVENT;
+
+/**
+ * @brief Latency accumulator for one transition.
+ */
+typedef struct {
+	char from[REPLAY_NAME_LEN];
+	char event[REPLAY_NAME_LEN];
+	char to[REPLAY_NAME_LEN];
+	unsigned long count;
+	double total_ns;
+	double max_ns;
+} REPLAY_TX;
+
+static REPLAY_EVENT* events = NULL;
+static int nevents = 0;
+static REPLAY_TX txstats[REPLAY_MAX_TX];
+static int ntx = 0;
+static REPLAY_TX* step_txp = NULL;		// transition being timed
+static double step_begin;				// when it started, nsec
+static int step_count;					// transitions so far in this sm_transition call
+
+/**
+ * @brief Command argument registration/definition
+ *
+ * @return Returns non-zero on error.
+ */
+static int register_cmdline() {
+	int status = 0;
+
+	status |= cmdarg_register_option("h", "help", CA_SWITCH, "Get help on this program", NULL, NULL);
+	status |= cmdarg_register_option("f", "file", CA_REQUIRED_ARG,
+			"Captured event stream to replay (required)", NULL, "h");
+	status |= cmdarg_register_option("n", "passes", CA_DEFAULT_ARG,
+			"Number of passes over the capture (default is 1)", "1", "h");
+	status |= cmdarg_register_option("t", "timed", CA_SWITCH,
+			"Replay at the recorded timing (default is maximum speed)", NULL, "h");
+	status |= cmdarg_register_option("v", "verbose", CA_SWITCH,
+			"Show action handler output", NULL, "h");
+	return status;
+}
+
+/**
+ * @brief Nanoseconds between two monotonic clock readings.
+ */
+static double elapsed_ns(struct timespec* startp, struct timespec* endp) {
+	return ((double)(endp->tv_sec - startp->tv_sec) * 1.0e9) + (double)(endp->tv_nsec - startp->tv_nsec);
+}
+
+/**
+ * @brief Find the URL encoded payload in one capture line.
+ *
+ * @param line The capture line (newline already stripped).
+ * @param timestampp Receives a leading epoch timestamp, 0 if none.
+ * @return Pointer to the payload within line, NULL if the line carries no event.
+ */
+static char* parse_capture_line(char* line, double* timestampp) {
+	char* cp = line;
+	char* endp;
+	char* argp;
+
+	*timestampp = 0;
+	if ((*cp >= '0') && (*cp <= '9')) {
+		*timestampp = strtod(cp, &endp);
+		cp = endp;
+		while (*cp == ' ') {
+			cp++;
+		}
+	}
+	if (0 == strncmp(cp, "LINE", 4)) {
+		// "LINE: payload" or "LINE [bytes = n]: payload"
+		cp = strstr(cp, ": ");
+		if (NULL == cp) {
+			return NULL;
+		}
+		cp += 2;
+	}
+	// Only lines that will be kept get decoded: the demo has no way to
+	// hand a decoded argument list back.
+	for (argp = cp; NULL != argp; argp = strchr(argp, '&')) {
+		if (*argp == '&') {
+			argp++;
+		}
+		if ((0 == strncmp(argp, "event=", 6)) && (argp[6] != '\0') && (argp[6] != '&')) {
+			return cp;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Read and decode the capture file.
+ *
+ * @param path Path of the capture file.
+ * @return Number of events loaded, -1 on error.
+ */
+static int load_capture(char* path) {
+	FILE* fp;
+	char line[2048];
+	char* payload;
+	double timestamp;
+	int allocated = 0;
+	REPLAY_EVENT* evp;
+	REPLAY_EVENT* newp;
+
+	fp = fopen(path, "r");
+	if (NULL == fp) {
+		fprintf(stderr, "Unable to open %s: errno = %d | %s\n", path, errno, strerror(errno));
+		return -1;
+	}
+	while (NULL != fgets(line, sizeof(line), fp)) {
+		line[strcspn(line, "\r\n")] = '\0';
+		payload = parse_capture_line(line, &timestamp);
+		if (NULL == payload) {
+			continue;
+		}
+		if (nevents == allocated) {
+			allocated = (allocated == 0) ? 1024 : (allocated * 2);
+			newp = realloc(events, allocated * sizeof(REPLAY_EVENT));
+			if (NULL == newp) {
+				fprintf(stderr, "Out of memory after %d events of %s\n", nevents, path);
+				fclose(fp);
+				return -1;
+			}
+			events = newp;
+		}
+		evp = &events[nevents];
+		memset(evp, 0, sizeof(REPLAY_EVENT));
+		evp->timestamp = timestamp;
+		// The list head gets its own allocation; events[] moves on realloc.
+		evp->arglistp = calloc(1, sizeof(LL_HEAD));
+		url_decode_arguments(evp->arglistp, payload);
+		evp->event = url_get_arg_value(evp->arglistp, "event");
+		evp->message = url_get_arg_value(evp->arglistp, "message");
+		if (NULL == evp->event) {
+			free(evp->arglistp);
+			continue;
+		}
+		nevents++;
+	}
+	fclose(fp);
+	return nevents;
+}
+
+/**
+ * @brief Find (or add) the accumulator for a transition.
+ *
+ * @return The accumulator, NULL if the table is full.
+ */
+static REPLAY_TX* find_tx(char* from, char* event, char* to) {
+	REPLAY_TX* txp = NULL;
+	int i;
+
+	for (i = 0; i < ntx; i++) {
+		txp = &txstats[i];
+		if ((0 == strcmp(txp->from, from)) && (0 == strcmp(txp->event, event)) && (0 == strcmp(txp->to, to))) {
+			break;
+		}
+	}
+	if (i == ntx) {
+		if (ntx == REPLAY_MAX_TX) {
+			return NULL;
+		}
+		txp = &txstats[ntx++];
+		strncpy(txp->from, from, sizeof(txp->from) - 1);
+		strncpy(txp->event, event, sizeof(txp->event) - 1);
+		strncpy(txp->to, to, sizeof(txp->to) - 1);
+	}
+	return txp;
+}
+
+/**
+ * @brief Account one transition's latency.
+ */
+static void record_tx(REPLAY_TX* txp, double ns) {
+	if (NULL == txp) {
+		return;
+	}
+	txp->count++;
+	txp->total_ns += ns;
+	if (ns > txp->max_ns) {
+		txp->max_ns = ns;
+	}
+}
+
+/**
+ * @brief CLOCK_MONOTONIC in nsec.
+ */
+static double now_ns() {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec * 1.0e9) + now.tv_nsec;
+}
+
+/**
+ * @brief demo_tx_hook: a transition starts, so the one before it in
+ * the same sm_transition call (if any) has ended. The first one is
+ * charged from the start of the call. Time spent here finding the
+ * accumulator is charged to neither.
+ */
+static void replay_tx_hook(char* from, char* event, char* to) {
+	double now = now_ns();
+	double carried = 0;
+
+	if (step_count++ > 0) {
+		record_tx(step_txp, now - step_begin);
+	} else {
+		carried = now - step_begin;
+	}
+	step_txp = find_tx(from, event, to);
+	step_begin = now_ns() - carried;
+}
+
+/**
+ * @brief Sleep until the recorded offset of an event has passed.
+ */
+static void pace(struct timespec* startp, double offset) {
+	struct timespec now;
+	struct timespec delay;
+	double wait;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	wait = offset - (elapsed_ns(startp, &now) / 1.0e9);
+	if (wait > 0) {
+		delay.tv_sec = (time_t)wait;
+		delay.tv_nsec = (long)((wait - (double)delay.tv_sec) * 1.0e9);
+		nanosleep(&delay, NULL);
+	}
+}
+
+/**
+ * @brief Push the loaded events through the state machine.
+ *
+ * @param machinep The demo state machine.
+ * @param passes Number of passes over the capture.
+ * @param timed Non-zero to honor the recorded timing.
+ * @return Number of events replayed.
+ */
+static unsigned long replay(SM_MACHINE* machinep, int passes, int timed) {
+	struct timespec start;
+	char from[REPLAY_NAME_LEN];
+	double first_ts = 0;
+	unsigned long count = 0;
+	int pass;
+	int i;
+	REPLAY_EVENT* evp;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (pass = 0; pass < passes; pass++) {
+		for (i = 0; i < nevents; i++) {
+			evp = &events[i];
+			if (0 == strcmp(evp->event, DEMO_SHUTDOWN_EVENT)) {
+				continue;
+			}
+			if (timed && (evp->timestamp > 0)) {
+				if (first_ts == 0) {
+					first_ts = evp->timestamp;
+				}
+				pace(&start, evp->timestamp - first_ts);
+			}
+			strncpy(from, sm_curr_state(machinep), sizeof(from) - 1);
+			from[sizeof(from) - 1] = '\0';
+			step_count = 0;
+			step_begin = now_ns();
+			sm_transition(machinep, evp->event, evp->message);
+
+			// Close the last transition, or time the event on its own
+			// if it took none.
+			if (step_count > 0) {
+				record_tx(step_txp, now_ns() - step_begin);
+			} else {
+				record_tx(find_tx(from, evp->event, from), now_ns() - step_begin);
+			}
+			count++;
+		}
+		// Timing is per capture; start the next pass from scratch.
+		if (timed && (first_ts > 0)) {
+			first_ts = 0;
+			clock_gettime(CLOCK_MONOTONIC, &start);
+		}
+	}
+	return count;
+}
+
+/**
+ * @brief Main program
+ *
+ */
+int main(int argc, char* argv[]) {
+	char path[512];
+	int passes;
+	int timed;
+	unsigned long count;
+	struct timespec start;
+	struct timespec end;
+	double seconds;
+	SM_MACHINE* machinep;
+	REPLAY_TX* txp;
+	int i;
+
+	cmdarg_init(argc, argv);
+	if (register_cmdline()) {
+		fprintf(stderr, "Registration error was reported!\n");
+	}
+	if (cmdarg_parse(argc, argv) || cmdarg_fetch_switch(NULL, "h")) {
+		cmdarg_show_help(NULL);
+		return 1;
+	}
+	cmdarg_load_string(path, sizeof(path), NULL, "f");
+	passes = cmdarg_fetch_int(NULL, "n");
+	timed = cmdarg_fetch_switch(NULL, "t");
+
+	// Action handler chatter would swamp the measurement.
+	if (cmdarg_fetch_switch(NULL, "v")) {
+		fdemolog = stdout;
+	} else {
+		fdemolog = fopen("/dev/null", "w");
+	}
+
+	if (load_capture(path) <= 0) {
+		fprintf(stderr, "No events found in %s\n", path);
+		return 1;
+	}
+	machinep = demo_machine_init();
+	demo_tx_hook = replay_tx_hook;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	count = replay(machinep, passes, timed);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	seconds = elapsed_ns(&start, &end) / 1.0e9;
+
+	fprintf(stdout, "Replayed %lu events (%d in capture, %d passes) in %.3f sec: %.0f events/sec\n",
+			count, nevents, passes, seconds, (seconds > 0) ? (count / seconds) : 0.0);
+	fprintf(stdout, "%-24s %-16s %-24s %10s %12s %12s\n",
+			"FROM", "EVENT", "TO", "COUNT", "MEAN (ns)", "MAX (ns)");
+	for (i = 0; i < ntx; i++) {
+		txp = &txstats[i];
+		fprintf(stdout, "%-24s %-16s %-24s %10lu %12.0f %12.0f\n", txp->from, txp->event, txp->to,
+				txp->count, txp->total_ns / txp->count, txp->max_ns);
+	}
+	return 0;
+}
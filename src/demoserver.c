@@ -57,11 +57,15 @@ X-Comment: On Debian systems, the complete text of the GNU General Public
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <cmdargs.h>
 #include <democonfig.h>
@@ -72,100 +76,32 @@ X-Comment: On Debian systems, the complete text of the GNU General Public
 #include <diagnostics.h>
 #include <sysconfig.h>
 #include <msgdeque.h>
+#include <msglanes.h>
+#include <smbcast.h>
+#include <evarchive.h>
 
-extern FILE* stdout;
-FILE* fdemolog;
-
-int server_latency;
-MSGCELL* recmsgcellp = NULL;
-
-// Declare the machine. We could allocate space
-// from the heap but this makes debugging easier.
-SM_MACHINE sm_machine;
-SM_MACHINE* machinep = NULL;
+#include "demomachine.h"
 
-// Declare the state table.
-SM_STATE_TABLE_DEF state_table;
-
-// event names. Define using the SMDEFNAME macro
-SMDEFNAME(DEMO_EVENT1)
-SMDEFNAME(DEMO_EVENT2)
-SMDEFNAME(DEMO_EVENT3)
-SMDEFNAME(DEMO_EVENT4)
-
-// Action list names.
-SMDEFNAME(DEMO_AL1)
-SMDEFNAME(DEMO_AL2)
-SMDEFNAME(DEMO_AL3)
-SMDEFNAME(DEMO_ALSHUTDOWN)
-
-// Action handler names
-SMDEFNAME(DEMO_AH1)
-SMDEFNAME(DEMO_AH2)
-SMDEFNAME(DEMO_AH3)
-SMDEFNAME(DEMO_AHSHUTDOWN)
-
-// State names
-SMDEFNAME(DEMO_STATE1)
-SMDEFNAME(DEMO_STATE2)
-SMDEFNAME(DEMO_STATE3)
-SMDEFNAME(DEMO_STATE_TERMINATED)
-
-// Transition names
-SMDEFNAME(DEMO_TX1)
-SMDEFNAME(DEMO_TX2)
-SMDEFNAME(DEMO_TX3)
-
-// Forward declarations for state machine action handlers
-SM_EVENT_HANDLE demo_actionhandler1(SM_MACHINE* machinep, void* datap);
-SM_EVENT_HANDLE demo_actionhandler2(SM_MACHINE* machinep, void* datap);
-SM_EVENT_HANDLE demo_actionhandler3(SM_MACHINE* machinep, void* datap);
-SM_EVENT_HANDLE demo_actionhandler_shutdown(SM_MACHINE* machinep, void* datap);
+#define DEQUE_SIZE_MIN 1024		// smallest deque_size accepted, bytes
+#define IDLE_CHECK_MSEC 1000	// longest an idle server waits before its once a second checks
 
-/**
- * @brief Action handler 1 will return EV_NULL_HANDLE, the null
- * event. No transition will be triggered.
- *
- * @param machinep Pointer to state machine data structure
- * @param datap Pointer to data transmitted by the URL encoded event (the message)
- * @return The event EV_NULL_HANDLE
- */
-SM_EVENT_HANDLE demo_actionhandler1(SM_MACHINE* machinep, void* datap) {
-	fprintf(fdemolog, "ActionHandler1: from state: %s message [%s] return EV_NULL\n", sm_curr_state(machinep), (char*)datap);
-	return EV_NULL_HANDLE;
-}
-
-/**
- * @brief Action handler 2 will return EV_NULL_HANDLE, the null
- * event. No transition will be triggered.
- *
- * @param machinep Pointer to state machine data structure
- * @param datap Pointer to data transmitted by the URL encoded event (the message)
- * @return The event EV_NULL_HANDLE
- */
-
-SM_EVENT_HANDLE demo_actionhandler2(SM_MACHINE* machinep, void* datap) {
-	fprintf(fdemolog, "ActionHandler2: from state: %s message [%s] return EV_NULL\n", sm_curr_state(machinep), (char*)datap);
-	return EV_NULL_HANDLE;
-}
+extern FILE* stdout;
 
-/**
- * @brief Action handler 3 will return DEMO_EVENT2, which should force
- * a transition from DEMO_STATE2 to DEMO_STATE1
- *
- * @param machinep Pointer to state machine data structure
- * @param datap Pointer to data transmitted by the URL encoded event (the message)
- * @return The event DEMO_EVENT2
- */
-SM_EVENT_HANDLE demo_actionhandler3(SM_MACHINE* machinep, void* datap) {
-	fprintf(fdemolog, "ActionHandler3: from state: %s message: [%s] return event DEMO_EVENT2\n", sm_curr_state(machinep), (char*)datap);
-	return sm_event_handle(machinep, DEMO_EVENT2);
-}
+int server_latency;		// simulated processing latency per event, msec
+int deque_size;			// size of each input lane deque, bytes
+int lane_burst;			// control lane receives before a bulk message gets a turn
+int archive_enabled;	// append processed events to the event archive
+int archive_flush_secs;	// longest an archived event waits in memory, sec
+SM_MACHINE* machinep = NULL;
+MSGLANES* reclanesp = NULL;
+SMBCAST* bcastp = NULL;
+EVARCH* archp = NULL;
+static uint64_t tx_serial;		// serial number of the event in the machine
+static int tx_count;			// transitions it has caused so far
 
-SM_EVENT_HANDLE demo_actionhandler_shutdown(SM_MACHINE* machinep, void* datap) {
-	fprintf(fdemolog, "ActionHandler SHUTDOWN ... exiting the demoserver from state %s\n", sm_curr_state(machinep));
-	return EV_NULL_HANDLE;
-}
+static void demo_publish_tx(char* from, char* event, char* to);
+static volatile sig_atomic_t shutdown_requested = 0;
+static volatile sig_atomic_t reload_requested = 0;
 
 /**
  * register command line arguments.
@@ -187,6 +123,46 @@ int register_cmdline(int argc, char* argv[]) {
 	return status;
 }
 
+/**
+ * @brief Load the tunable settings from the [demoserver] section
+ * of demoserver.ini. democonfig_load must have been called.
+ */
+static void load_settings() {
+	deque_size = democonfig_get_int("demoserver", "deque_size", 1024 * 10);
+	lane_burst = democonfig_get_int("demoserver", "lane_burst", DEMO_LANE_BURST);
+	server_latency = democonfig_get_int("demoserver", "latency", 0);
+	archive_enabled = democonfig_get_int("demoserver", "archive", 0);
+	archive_flush_secs = democonfig_get_int("demoserver", "archive_flush_secs", 10);
+
+	if (deque_size < DEQUE_SIZE_MIN) {
+		ULPPK_LOG(ULPPK_LOG_WARN, "deque_size %d is too small ... using %d", deque_size, DEQUE_SIZE_MIN);
+		deque_size = DEQUE_SIZE_MIN;
+	}
+}
+
+/**
+ * @brief Open or close the event archive to match the settings.
+ * The archive lives in the data directory; one that can't be opened
+ * is logged and left off.
+ */
+static void apply_archive_settings() {
+	char* dir;
+
+	if (archive_enabled && (NULL == archp)) {
+		dir = democonfig_get_string("environment", "data_dir", DEMO_DATA_DIR);
+		archp = evarch_open(dir, DEMO_EVENT_ARCHIVE, (S_IWUSR | S_IRUSR | S_IRGRP | S_IROTH));
+		if (NULL == archp) {
+			ULPPK_LOG(ULPPK_LOG_WARN, "Unable to open event archive %s/%s", dir, DEMO_EVENT_ARCHIVE);
+		}
+	} else if (!archive_enabled && (NULL != archp)) {
+		evarch_close(archp);
+		archp = NULL;
+	}
+	if (NULL != archp) {
+		archp->flush_secs = archive_flush_secs;
+	}
+}
+
 /**
  * @brief Statemachine initialization.
  *
@@ -197,71 +173,31 @@ int register_cmdline(int argc, char* argv[]) {
 int init_server() {
 	int retval;
 
-	// Set our output stream
-	fdemolog = stdout;
-
-	// Get a new state machine
-	machinep = sm_new_machine(&sm_machine, &state_table, "demomachine");
-
-	// Register stock events and definitions
-	sm_register_stock_defs(machinep);
-
-	// Define the events.
-	sm_register_event(machinep, DEMO_EVENT1);
-	sm_register_event(machinep, DEMO_EVENT2);
-	sm_register_event(machinep, DEMO_EVENT3);
-	sm_register_event(machinep, DEMO_EVENT4);
-
-	// Define the action lists.
-
-	sm_register_action_list(machinep, DEMO_AL1);
-	sm_register_action_list(machinep, DEMO_AL2);
-	sm_register_action_list(machinep, DEMO_AL3);
-	sm_register_action_list(machinep, DEMO_ALSHUTDOWN);
-
-	// Now register the action handlers
-	// Action list 1: Just calls demo_actionhandler1
-	sm_register_action(machinep, DEMO_AL1, DEMO_AH1, demo_actionhandler1);
-
-	// Action List 2: Calls demo_actionhandler_2 and 3
-	sm_register_action(machinep, DEMO_AL2, DEMO_AH2, demo_actionhandler2);
-	sm_register_action(machinep, DEMO_AL2, DEMO_AH3, demo_actionhandler3);
-
-	// Action list 3: Just calls demo_actionhandler3
-	sm_register_action(machinep, DEMO_AL3, DEMO_AH3, demo_actionhandler3);
-
-	// This action list is used by the "global transition" for shutdown.
-	// WE could use any action list for that purpose, in principal.
-	sm_register_action(machinep, DEMO_ALSHUTDOWN, DEMO_AHSHUTDOWN, demo_actionhandler_shutdown);
-
-	// Define the machine states
-	sm_register_state(machinep, DEMO_STATE1);
-	sm_register_state(machinep, DEMO_STATE2);
-	sm_register_state(machinep, DEMO_STATE3);
-	sm_register_state(machinep, DEMO_STATE_TERMINATED);
-
-	// Now register the state transitions
-	sm_register_transition(machinep, DEMO_STATE1, DEMO_STATE2, DEMO_EVENT1, DEMO_AL1);
-	sm_register_transition(machinep, DEMO_STATE1, DEMO_STATE3, DEMO_EVENT3, DEMO_AL2);
-	sm_register_transition(machinep, DEMO_STATE2, DEMO_STATE1, DEMO_EVENT2, DEMO_AL2);
-	sm_register_transition(machinep, DEMO_STATE2, DEMO_STATE3, DEMO_EVENT1, DEMO_AL1);
-	sm_register_transition(machinep, DEMO_STATE3, DEMO_STATE1, DEMO_EVENT1, DEMO_AL1);
-	sm_register_transition(machinep, DEMO_STATE3, DEMO_STATE2, DEMO_EVENT3, DEMO_AL3);
-	sm_register_transition(machinep, DEMO_STATE3, DEMO_STATE2, DEMO_EVENT2, DEMO_AL2);
-
-	// here's a global transition. When DEMO_EVENT4 is detected from any state, transition
-	// to shut down and transition to state DEMO_TERMINATED (dead) state.
+	load_settings();
 
-	sm_register_global_transition(machinep, DEMO_STATE_TERMINATED, DEMO_EVENT4, DEMO_ALSHUTDOWN);
+	// Define the demo state machine (see demomachine.c), and have
+	// it report every transition it takes.
+	machinep = demo_machine_init();
+	demo_tx_hook = demo_publish_tx;
 
-	// Mark the state machine definition as being complete
-	sm_set_definition_complete(machinep);
+	// Now set up the input message deque. It is a lane set: control
+	// events arrive on DEMO_LANE_CONTROL and are received ahead of
+	// any bulk traffic already queued on DEMO_LANE_BULK.
+	reclanesp = msglanes_create(DEMO_SERVER_LANES, (S_IWUSR | S_IRUSR | S_IWGRP | S_IRGRP), deque_size,
+			DEMO_NLANES, lane_burst);
+	if (NULL == reclanesp) {
+		ULPPK_CRASH("Unable to create stream message lanes: demo-server");
+	}
+	msglanes_set_timeout(reclanesp, IDLE_CHECK_MSEC);
 
-	// Now set up the input message deque
-	recmsgcellp = msgdeque_create_byte_stream("demo-server", (S_IWUSR | S_IRUSR | S_IWGRP | S_IRGRP), (1024*10));
-	if (NULL == recmsgcellp) {
-		ULPPK_CRASH("Unable to create stream message deque: demo-server");
+	// Transitions are published here. Subscribers are optional,
+	// so a ring we can't set up costs us the feed, not the server.
+	bcastp = smbcast_create(DEMO_TRANSITION_BCAST, (S_IWUSR | S_IRUSR | S_IRGRP | S_IROTH), DEMO_BCAST_SLOTS);
+	if (NULL == bcastp) {
+		ULPPK_LOG(ULPPK_LOG_WARN, "Unable to create transition broadcast ring: %s", DEMO_TRANSITION_BCAST);
 	}
+
+	apply_archive_settings();
 	return 0;
 }
 
@@ -289,9 +225,167 @@ char* get_urlarg(PLL_HEAD listp, char* namep) {
 	return valp;
 }
 
+/**
+ * @brief Archive one transition (or an event that took none).
+ */
+static void demo_archive(char* from, char* event, char* to) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	evarch_append(archp, ((int64_t)ts.tv_sec * 1000000000LL) + ts.tv_nsec, from, to, event, tx_serial);
+}
+
+/**
+ * @brief Write out the archive block once it is archive_flush_secs old,
+ * even if no further event arrives to trigger it.
+ */
+static void demo_archive_idle() {
+	struct timespec ts;
+
+	if (NULL != archp) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		evarch_flush_if_due(archp, ((int64_t)ts.tv_sec * 1000000000LL) + ts.tv_nsec);
+	}
+}
+
+/**
+ * @brief demo_tx_hook: publish each transition the machine takes on the
+ * broadcast ring, and archive it. An event an action handler returns
+ * makes a transition of its own, so one event can publish several.
+ */
+static void demo_publish_tx(char* from, char* event, char* to) {
+	tx_count++;
+	if (NULL != bcastp) {
+		smbcast_publish(bcastp, from, to, event, tx_serial);
+	}
+	if (NULL != archp) {
+		demo_archive(from, event, to);
+	}
+}
+
+/**
+ * @brief Push one event into the state machine. The transitions it
+ * causes are published by demo_publish_tx.
+ *
+ * @param event Event name.
+ * @param message Data for the action handlers.
+ * @param serialnumber Serial number string from the event (may be NULL).
+ */
+static void demo_transition(char* event, char* message, char* serialnumber) {
+	char old_state[SMBCAST_NAME_LEN];
+
+	strncpy(old_state, sm_curr_state(machinep), sizeof(old_state) - 1);
+	old_state[sizeof(old_state) - 1] = '\0';
+	tx_serial = (NULL == serialnumber) ? 0 : strtoull(serialnumber, NULL, 10);
+	tx_count = 0;
+
+	// Pass the event to the state machine. Data is the incoming message
+	sm_transition(machinep, event, message);
+
+	// The archive keeps events that took no transition as well.
+	if ((0 == tx_count) && (NULL != archp)) {
+		demo_archive(old_state, event, old_state);
+	}
+}
+
+/**
+ * @brief Signal handler for SIGTERM and SIGINT. Requests a graceful
+ * shutdown; the demoserver loop does the work.
+ */
+static void demo_sigshutdown(int signo) {
+	shutdown_requested = 1;
+	if (NULL != reclanesp) {
+		msglanes_wake(reclanesp);		// in case the loop is about to block
+	}
+}
+
+/**
+ * @brief Signal handler for SIGHUP. Requests a settings reload.
+ */
+static void demo_sighup(int signo) {
+	reload_requested = 1;
+	if (NULL != reclanesp) {
+		msglanes_wake(reclanesp);
+	}
+}
+
+/**
+ * @brief Install the shutdown and reload signal handlers. SA_RESTART
+ * is left off so a blocked receive returns and the loop sees the request.
+ */
+static void install_signal_handlers() {
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = demo_sigshutdown;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+
+	sa.sa_handler = demo_sighup;
+	sigaction(SIGHUP, &sa, NULL);
+}
+
+/**
+ * @brief Re-read demoserver.ini and apply it to the running server.
+ *
+ * Logging settings are re-applied by ulppk. A new deque_size is
+ * picked up by apply_deque_size. Events waiting for the archive are
+ * written out, so a reload also brings the archive up to date for queries.
+ */
+static void demo_reload() {
+	sysconfig_parse_inifile("demoserver");
+	democonfig_load("demoserver");
+	load_settings();
+
+	msglanes_set_burst(reclanesp, lane_burst);
+	if (NULL != archp) {
+		evarch_flush(archp);
+	}
+	apply_archive_settings();
+	fprintf(fdemolog, "Settings reloaded: deque_size = %d lane_burst = %d latency = %d msec archive = %s\n",
+			deque_size, lane_burst, server_latency, (NULL == archp) ? "off" : "on");
+	fflush(fdemolog);
+}
+
+/**
+ * @brief Bring the input lanes to the configured deque_size.
+ *
+ * The lanes are migrated to new deques of that size (see
+ * msglanes_resize); queued events are not lost or reordered. While an
+ * earlier resize is still draining this does nothing, and the resize
+ * is tried again on the next pass of the receive loop.
+ */
+static void apply_deque_size() {
+	if ((size_t)deque_size == reclanesp->ctlp->lane_size) {
+		return;
+	}
+	if (msglanes_resize(reclanesp, deque_size)) {
+		if (EBUSY != reclanesp->errcode) {
+			ULPPK_LOG(ULPPK_LOG_WARN, "Unable to resize input deque to %d bytes: error code [%d] ... keeping %d",
+					deque_size, reclanesp->errcode, (int)reclanesp->ctlp->lane_size);
+			deque_size = (int)reclanesp->ctlp->lane_size;
+		}
+		return;
+	}
+	fprintf(fdemolog, "Input deque resized to %d bytes\n", deque_size);
+	fflush(fdemolog);
+}
+
 /**
  * @brief Loop obtains requests and pushes them into the state machine
  * as events.
+ *
+ * Shutdown (DEMO_EVENT4 or SIGTERM/SIGINT) drains rather than stops:
+ * the input lanes are closed so senders are refused, every event
+ * already accepted is pushed through the state machine, and only then
+ * is the shutdown transition taken. Counts of processed and dropped
+ * events are reported on the way out.
+ *
+ * Settings are reloaded on SIGHUP, and when demoserver.ini has
+ * changed (checked about once a second, between events or while idle).
+ *
+ * @return 0 on clean shutdown.
  */
 int demoserver()  {
 	int retstatus = 0;
@@ -302,17 +396,50 @@ int demoserver()  {
 	char* message;
 	char* serialnumber;
 	size_t bytes_received;
+	int draining = 0;
+	char* shutdown_message = NULL;
+	char* shutdown_serial = NULL;
+	unsigned long processed = 0;
+	unsigned long dropped = 0;
+	time_t last_check = time(NULL);
+	time_t now;
 
 	// TSTRACE("MPF Executes ... CONNECTION ESTABLISHED");
 
 	while (1) {
-		buff = msgdeque_rec_byte_stream(recmsgcellp, &bytes_received);
+		now = time(NULL);
+		if (now != last_check) {
+			last_check = now;
+			if (democonfig_changed()) {
+				reload_requested = 1;
+			}
+			demo_archive_idle();
+		}
+		if (reload_requested && !draining) {
+			reload_requested = 0;
+			demo_reload();
+		}
+		if (!draining) {
+			apply_deque_size();
+		}
+		if (shutdown_requested && !draining) {
+			draining = 1;
+			fprintf(fdemolog, "Shutdown requested ... draining %d queued events\n", msglanes_close(reclanesp));
+			fflush(fdemolog);
+		}
+		if (draining && (0 == msglanes_pending(reclanesp))) {
+			break;
+		}
+
+		buff = msglanes_rec_byte_stream(reclanesp, &bytes_received, NULL);
 		if (NULL == buff) {
-			ULPPK_LOG(ULPPK_LOG_WARN, "Received NULL data on input queue");
-		} else {
-			fprintf(stdout, "LINE [bytes = %u]: %s\n", (unsigned int)bytes_received, buff);
-			fflush(stdout);
+			if ((EINTR != reclanesp->errcode) && (ETIMEDOUT != reclanesp->errcode)) {
+				ULPPK_LOG(ULPPK_LOG_WARN, "Received NULL data on input queue");
+			}
+			continue;
 		}
+		fprintf(stdout, "LINE [bytes = %u]: %s\n", (unsigned int)bytes_received, buff);
+		fflush(stdout);
 
 		// Decode the URL encoded arguments
 		url_decode_arguments(&arglist, buff);
@@ -320,10 +447,43 @@ int demoserver()  {
 		message = get_urlarg(&arglist, "message");
 		serialnumber = get_urlarg(&arglist, "serialnumber");
 		free(buff);
-		// Pass the event to the state machine. Data is the incoming message
-		sm_transition(machinep, event, message);
+		if (NULL == event) {
+			dropped++;
+			continue;
+		}
+
+		// Hold the shutdown event back until everything queued
+		// ahead of (or behind) it has been through the machine.
+		if (0 == strcmp(event, DEMO_SHUTDOWN_EVENT)) {
+			if (NULL == shutdown_message) {
+				shutdown_message = strdup((NULL == message) ? "" : message);
+				shutdown_serial = (NULL == serialnumber) ? NULL : strdup(serialnumber);
+				shutdown_requested = 1;
+			} else {
+				dropped++;		// duplicate shutdown
+			}
+			continue;
+		}
+
+		demo_transition(event, message, serialnumber);
+		processed++;
+		if (server_latency > 0) {
+			usleep(server_latency * 1000);
+		}
 	}
-	return 0;
+
+	// Queue is empty and closed. Now take the shutdown transition.
+	demo_transition(DEMO_SHUTDOWN_EVENT, (NULL == shutdown_message) ? "signal" : shutdown_message, shutdown_serial);
+	processed++;
+	free(shutdown_message);
+	free(shutdown_serial);
+	evarch_close(archp);
+	archp = NULL;
+
+	fprintf(fdemolog, "demoserver drained: %lu events processed, %lu dropped, %d refused at the deque\n",
+			processed, dropped, reclanesp->ctlp->rejected);
+	fflush(fdemolog);
+	return retstatus;
 }
 
 int main(int argc, char* argv[]) {
@@ -335,6 +495,6 @@ int main(int argc, char* argv[]) {
 	app_init("demoserver", argc, argv);
 	register_cmdline(argc, argv);
 	init_server();
-	demoserver();
-	return 0;
+	install_signal_handlers();
+	return demoserver();
 }
@@ -48,7 +48,8 @@ X-Comment: On Debian systems, the complete text of the GNU General Public
  * <li>DEMO_EVENT1</li>
  * <li>DEMO_EVENT2</li>
  * <li>DEMO_EVENT3</li>
- * <li>DEMO_EVENT4 -- the shutdown command shutsdown demoserver</li>
+ * <li>DEMO_EVENT4 -- the shutdown command shutsdown demoserver once every
+ * event queued ahead of it has been processed</li>
  * </ul>
  *
  * <h1>Running the Demo</h1>
@@ -61,6 +62,10 @@ X-Comment: On Debian systems, the complete text of the GNU General Public
  * Then issue event commands like
  *
  * demosocketclient -e DEMO_EVENT1 -m "This is a random message"
+ *
+ * To deliver many events over a single connection, feed them on stdin:
+ *
+ * printf "DEMO_EVENT1 first\nDEMO_EVENT3 second\n" | demosocketclient -s
  */
 
 /*
@@ -77,6 +82,9 @@ X-Comment: On Debian systems, the complete text of the GNU General Public
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 #include <cmdargs.h>
 #include <socketio.h>
@@ -104,6 +112,8 @@ int sockfd;
  * -e --event: event to send. The events are strings identifying the event (like "myevent1")
  * 		events carry a message string.
  * -m -- message: message to send along with the event
+ * -s --stdin: connection reuse mode. Read "EVENT [message]" lines from
+ * 		stdin and send them all over the one connection.
  *
  * @return Returns non-zero on error.
  */
@@ -129,14 +139,19 @@ static int register_cmdline() {
 	status |= cmdarg_register_option("n", "packet-count", CA_DEFAULT_ARG,
 			"Number of packets to send (0 => infite, default is 1", "1", "H");
 
-	// Define the event argument. This is required, and a value must be provided.
-	status |= cmdarg_register_option("e","event",CA_REQUIRED_ARG, "Event identifier string (required)", NULL, "H");
+	// Define the event argument. Required unless events come from stdin (-s).
+	status |= cmdarg_register_option("e","event",CA_DEFAULT_ARG,
+			"Event identifier string (required unless -s)", "", "H");
 
 	// Define the message argument. If not provided, a default value of
 	// "eventmessage=demosocketclient" will be sent.
 	status |= cmdarg_register_option("m", "message", CA_DEFAULT_ARG,
 			"Event message string (default is \"eventmessage=demosocketclient)\"", NULL, "H" );
 
+	// Connection reuse mode: many events, one connection.
+	status |= cmdarg_register_option("s", "stdin", CA_SWITCH,
+			"Read \"EVENT [message]\" lines from stdin and send them over one connection", NULL, "H");
+
 	return status;
 }
 
@@ -150,23 +165,27 @@ static int register_cmdline() {
  * @param serialnumber Event serial number.
  * @param event Event name string
  * @param message Message to include with the event.
- * @return Pointer to the formatted event. (Same as input buffer.)
+ * @return Pointer to the formatted event. (Same as input buffer.) NULL
+ * if the encoded event, plus the newline the caller appends, doesn't fit.
  */
 char* fmt_event(char* buffer, size_t buffsize, int serialnumber, char* event, char* message) {
 	char *evp;
 	char* urlargs;
 	char snbuff[16];
 
-	if (buffsize < (strlen(event) + 6 + strlen(message) + 9 + 12 + 3)) {
-		fprintf(stderr, "Increase eventbuff size in event_generator ... aborting\n");
-		exit(1);
-	}
 	// sprintf(buffer, "event=\"%s\"&message=\"%s\"&serialnumber=\"%d\"\n", event, message, serialnumber);
 	sprintf(snbuff, "%d", serialnumber);
 	urlargs = url_encode_arguments(NULL, "event", event);
 	urlargs = url_encode_arguments(urlargs, "message", message);
 	urlargs = url_encode_arguments(urlargs, "serialnumber", snbuff);
-	strncpy(buffer, urlargs, buffsize);
+
+	// URL encoding can triple the length of the message, so check
+	// the encoded string: room for it, the newline and the NUL.
+	if ((strlen(urlargs) + 2) > buffsize) {
+		free(urlargs);
+		return NULL;
+	}
+	strcpy(buffer, urlargs);
 	free(urlargs);
 	evp = buffer;
 	return evp;
@@ -192,7 +211,10 @@ int event_generator(char* hostname, char* event, char* message, int npackets) {
 	int eventlen;
 
 	for (i=0; i < npackets; i++) {
-		fmt_event(eventbuff, sizeof(eventbuff), i, event, message);
+		if (NULL == fmt_event(eventbuff, sizeof(eventbuff), i, event, message)) {
+			fprintf(stderr, "Increase eventbuff size in event_generator ... aborting\n");
+			exit(1);
+		}
 		strcat(eventbuff, "\n");
 		eventlen = strlen(eventbuff);
 		sio_writen(sockfd, eventbuff, eventlen);
@@ -200,6 +222,62 @@ int event_generator(char* hostname, char* event, char* message, int npackets) {
 	return 0;
 }
 
+/**
+ * @brief Connection reuse mode. Sends one event per stdin line over the
+ * already open connection, so a caller with many events to deliver
+ * pays for one connect instead of one per event.
+ *
+ * Each line is "EVENT [message]". A line without a message uses the
+ * -m message. Serial numbers run on across the whole stream. Lines
+ * too long to send are reported and skipped.
+ *
+ * @param defmessage Message for lines that don't carry one.
+ * @return 0 on success.
+ */
+int stdin_event_generator(char* defmessage) {
+	char line[512];
+	char eventbuff[1024];
+	char* evp;
+	char* msgp;
+	int serialnumber = 0;
+	int lineno = 0;
+	int c;
+
+	while (NULL != fgets(line, sizeof(line), stdin)) {
+		lineno++;
+
+		// No newline: fgets stopped short of the end of the line.
+		// Drop the rest of it rather than send it as another event.
+		if ((NULL == strchr(line, '\n')) && !feof(stdin)) {
+			fprintf(stderr, "Line %d longer than %d bytes ... skipped\n", lineno, (int)sizeof(line) - 2);
+			while (((c = getchar()) != EOF) && (c != '\n')) {
+				;
+			}
+			continue;
+		}
+		line[strcspn(line, "\r\n")] = '\0';
+		evp = strtok(line, " \t");
+		if (NULL == evp) {
+			continue;
+		}
+		msgp = strtok(NULL, "");
+		if (NULL == msgp) {
+			msgp = defmessage;
+		}
+		if (NULL == fmt_event(eventbuff, sizeof(eventbuff), serialnumber, evp, msgp)) {
+			fprintf(stderr, "Line %d too long once URL encoded ... skipped\n", lineno);
+			continue;
+		}
+		serialnumber++;
+		strcat(eventbuff, "\n");
+		if (sio_writen(sockfd, eventbuff, strlen(eventbuff)) < 0) {
+			fprintf(stderr, "Send failed after %d events\n", serialnumber - 1);
+			return 1;
+		}
+	}
+	return 0;
+}
+
 /**
  * @brief Main program
  *
@@ -212,6 +290,8 @@ int main(int argc, char* argv[]) {
 	char* messagep;
 	int port_number;
 	int exit_status;
+	int stdinflag;
+	int on = 1;
 
 	sysconfig_set_logging(ULPPK_LOGDEST_ALL, "demosocketclient", LOG_PID, LOG_LOCAL1);
 	app_init("demosocketclient", argc, argv);
@@ -243,6 +323,12 @@ int main(int argc, char* argv[]) {
 	cmdarg_load_string(event, sizeof(event), NULL, "e");
 	cmdarg_load_string(message, sizeof(message), NULL, "m");
 	npackets = cmdarg_fetch_int(NULL, "n");
+	stdinflag = cmdarg_fetch_switch(NULL, "s");
+	if (!stdinflag && (event[0] == '\0')) {
+		fprintf(stderr, "An event (-e) is required unless events are read from stdin (-s)\n");
+		cmdarg_show_help(NULL);
+		return 1;
+	}
 
 	// Connect to the server
 	sockfd = sio_connectbyhostname(hostname, port_number);
@@ -251,8 +337,21 @@ int main(int argc, char* argv[]) {
 		exit(1);
 	}
 
+	// Events go out as soon as they are written. In reuse mode the
+	// connection may sit idle between bursts, so keep it alive.
+	if (democonfig_get_int("socketclient", "tcp_nodelay", 1)) {
+		setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	}
+	if (stdinflag && democonfig_get_int("socketclient", "keepalive", 1)) {
+		setsockopt(sockfd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+	}
+
 	// Now call the event generator
-	exit_status = event_generator(hostname, event, message, npackets);
+	if (stdinflag) {
+		exit_status = stdin_event_generator(message);
+	} else {
+		exit_status = event_generator(hostname, event, message, npackets);
+	}
 
 	return exit_status;
 }
@@ -38,9 +38,20 @@ X-Comment: On Debian systems, the complete text of the GNU General Public
  *      Author: robgarv
  */
 
+#define _GNU_SOURCE		// accept4
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 #include <cmdargs.h>
 #include <democonfig.h>
@@ -53,10 +64,278 @@ X-Comment: On Debian systems, the complete text of the GNU General Public
 #include <diagnostics.h>
 #include <sysconfig.h>
 #include <msgdeque.h>
+#include <msglanes.h>
 
-static MSGCELL* xmtmsgcellp = NULL;		// send data to the server on this deque
+static MSGLANES* xmtlanesp = NULL;		// send data to the server on these lanes
 static MSGCELL* recmsgcellp = NULL;		// receive data from the server on this deque
 
+#define MAX_LISTENERS 64
+#define RESTART_POLL_MSEC 10	// how often a held line checks for a restarted demoserver
+#define RELOAD_POLL_MSEC 1000	// how often an idle server looks for settings changes
+
+/**
+ * @brief Connection handling settings, from the [socketserver] section
+ * of demosocketserver.ini.
+ */
+typedef struct {
+	int listeners;		///< 0: single ulppk socketserver listener. N: N SO_REUSEPORT listener processes
+	int port;			///< Listen port (listener processes only; ulppk takes -p)
+	int backlog;		///< Accept backlog (listener processes only)
+	int accept_batch;	///< Connections taken per wakeup (listener processes only)
+	int tcp_nodelay;	///< Set TCP_NODELAY on each connection
+	int tcp_quickack;	///< Keep TCP_QUICKACK armed on each connection
+	int rcvbuf;			///< SO_RCVBUF for each connection (0: system default)
+	int sndbuf;			///< SO_SNDBUF for each connection (0: system default)
+	int idle_timeout;	///< Seconds a connection may sit idle (0: forever)
+	int read_buffer_size;		///< Longest event line accepted, in bytes
+	int backpressure_high;		///< Hold off reading while demoserver has this many messages pending (0: never)
+	int backpressure_delay;		///< Milliseconds to wait between backpressure checks
+	int restart_wait;			///< Seconds to hold a line for a restarting demoserver (0: for ever)
+} SERVER_SETTINGS;
+
+static SERVER_SETTINGS settings;
+static volatile sig_atomic_t listener_stop = 0;
+static volatile sig_atomic_t reload_requested = 0;
+static time_t reload_checked = 0;
+static int listener_process = 0;		// running listener_worker rather than under ssrvr_start
+static pthread_mutex_t reload_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static char* buff = NULL;				// event line buffer, settings.read_buffer_size bytes
+static size_t buffsize = 0;
+
+// Events sent on the control lane of the demoserver deque.
+static char* control_events[] = {
+	"DEMO_EVENT4",		// shutdown (global transition)
+	NULL
+};
+
+/**
+ * @brief Load connection handling settings from the ini file.
+ */
+static void load_settings() {
+	settings.listeners = democonfig_get_int("socketserver", "listeners", 0);
+	settings.port = democonfig_get_int("socketserver", "port", 49152);
+	settings.backlog = democonfig_get_int("socketserver", "backlog", 1024);
+	settings.accept_batch = democonfig_get_int("socketserver", "accept_batch", 32);
+	settings.tcp_nodelay = democonfig_get_int("socketserver", "tcp_nodelay", 1);
+	settings.tcp_quickack = democonfig_get_int("socketserver", "tcp_quickack", 0);
+	settings.rcvbuf = democonfig_get_int("socketserver", "rcvbuf", 0);
+	settings.sndbuf = democonfig_get_int("socketserver", "sndbuf", 0);
+	settings.idle_timeout = democonfig_get_int("socketserver", "idle_timeout", 0);
+	settings.read_buffer_size = democonfig_get_int("socketserver", "read_buffer_size", 1024);
+	settings.backpressure_high = democonfig_get_int("socketserver", "backpressure_high", 0);
+	settings.backpressure_delay = democonfig_get_int("socketserver", "backpressure_delay_ms", 5);
+	settings.restart_wait = democonfig_get_int("socketserver", "restart_wait", 60);
+
+	if (settings.listeners > MAX_LISTENERS) {
+		settings.listeners = MAX_LISTENERS;
+	}
+	if (settings.accept_batch < 1) {
+		settings.accept_batch = 1;
+	}
+	if (settings.read_buffer_size < 64) {
+		settings.read_buffer_size = 64;
+	}
+	if (settings.backpressure_delay < 1) {
+		settings.backpressure_delay = 1;
+	}
+}
+
+/**
+ * @brief SIGHUP handler: reload settings at the next convenient point.
+ */
+static void demo_sighup(int signo) {
+	reload_requested = 1;
+}
+
+/**
+ * @brief Re-read the ini file and pick up the new settings.
+ *
+ * Socket options, buffer size and backpressure settings apply from the
+ * next connection or line on. The listen port and backlog belong to
+ * sockets that are already open, so those only change on restart.
+ *
+ * @param ulppk Non-zero to re-read the ulppk (sysconfig) settings too.
+ * Only safe in a single threaded process; see reload_thread.
+ */
+static void reload_settings(int ulppk) {
+	int port = settings.port;
+	int backlog = settings.backlog;
+
+	reload_requested = 0;
+	if (ulppk) {
+		sysconfig_parse_inifile("demosocketserver");
+	}
+	democonfig_load("demosocketserver");
+	load_settings();
+	settings.port = port;
+	settings.backlog = backlog;
+	fprintf(stdout, "Settings reloaded: listeners = %d accept_batch = %d read_buffer_size = %d backpressure_high = %d\n",
+			settings.listeners, settings.accept_batch, settings.read_buffer_size, settings.backpressure_high);
+	fflush(stdout);
+}
+
+/**
+ * @brief Reload settings if SIGHUP arrived or the ini file was edited.
+ * The file is looked at no more than once a second.
+ */
+static void check_reload() {
+	time_t now = time(NULL);
+
+	if (!reload_requested && (now != reload_checked)) {
+		reload_checked = now;
+		if (democonfig_changed()) {
+			reload_requested = 1;
+		}
+	}
+	if (reload_requested) {
+		reload_settings(1);
+	}
+}
+
+/**
+ * @brief fork() handlers for the reload thread: hold off forking a
+ * connection process while the settings are half reloaded.
+ */
+static void reload_prepare_fork() {
+	pthread_mutex_lock(&reload_lock);
+}
+
+static void reload_after_fork() {
+	pthread_mutex_unlock(&reload_lock);
+}
+
+/**
+ * @brief Reload thread for the ulppk socketserver parent.
+ *
+ * ssrvr_start's accept loop has no hook of ours in it, so this thread
+ * picks up SIGHUP and ini file changes there instead. Connection
+ * processes forked afterwards start out with the new settings, rather
+ * than each noticing the change and reloading for itself.
+ *
+ * SIGHUP is blocked in every thread and taken here with sigtimedwait,
+ * so no handler runs in the accept loop. The thread only re-reads the
+ * demo's own settings, which nothing but our personality functions
+ * (run in the connection processes) reads; sysconfig's state is shared
+ * with the accept loop, so ulppk settings under ssrvr_start take a
+ * restart. reload_lock keeps a fork from copying half a reload.
+ */
+static void* reload_thread(void* datap) {
+	sigset_t hup;
+	struct timespec ts;
+	int signo;
+
+	sigemptyset(&hup);
+	sigaddset(&hup, SIGHUP);
+	ts.tv_sec = RELOAD_POLL_MSEC / 1000;
+	ts.tv_nsec = (RELOAD_POLL_MSEC % 1000) * 1000000L;
+	while (1) {
+		signo = sigtimedwait(&hup, NULL, &ts);
+		pthread_mutex_lock(&reload_lock);
+		if ((SIGHUP == signo) || democonfig_changed()) {
+			reload_settings(0);
+		}
+		pthread_mutex_unlock(&reload_lock);
+	}
+	return NULL;
+}
+
+/**
+ * @brief Make sure the line buffer matches settings.read_buffer_size.
+ *
+ * @return 0 on success, -1 if the buffer could not be allocated.
+ */
+static int size_buffer() {
+	char* newbuff;
+
+	if ((NULL != buff) && (buffsize == (size_t)settings.read_buffer_size)) {
+		return 0;
+	}
+	newbuff = realloc(buff, settings.read_buffer_size);
+	if (NULL == newbuff) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to allocate %d byte read buffer", settings.read_buffer_size);
+		return (NULL == buff) ? -1 : 0;		// keep the old buffer if there is one
+	}
+	buff = newbuff;
+	buffsize = settings.read_buffer_size;
+	return 0;
+}
+
+/**
+ * @brief Hold off reading the connection while demoserver is behind.
+ *
+ * Lines left unread stay in the socket receive buffer, so a busy
+ * demoserver slows its clients down through TCP flow control instead
+ * of letting its input deque fill up and refuse sends.
+ */
+static void apply_backpressure() {
+	struct timespec ts;
+
+	if (settings.backpressure_high <= 0) {
+		return;
+	}
+	ts.tv_sec = settings.backpressure_delay / 1000;
+	ts.tv_nsec = (settings.backpressure_delay % 1000) * 1000000L;
+	while ((msglanes_pending(xmtlanesp) >= settings.backpressure_high) && !msglanes_closed(xmtlanesp)) {
+		nanosleep(&ts, NULL);
+	}
+}
+
+/**
+ * @brief Apply the configured socket options to an accepted connection.
+ *
+ * @param connfd The socket connection file descriptor.
+ */
+static void apply_socket_options(int connfd) {
+	int on = 1;
+	struct timeval tv;
+
+	if (settings.tcp_nodelay) {
+		setsockopt(connfd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	}
+	if (settings.tcp_quickack) {
+		setsockopt(connfd, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof(on));
+	}
+	if (settings.rcvbuf > 0) {
+		setsockopt(connfd, SOL_SOCKET, SO_RCVBUF, &settings.rcvbuf, sizeof(settings.rcvbuf));
+	}
+	if (settings.sndbuf > 0) {
+		setsockopt(connfd, SOL_SOCKET, SO_SNDBUF, &settings.sndbuf, sizeof(settings.sndbuf));
+	}
+	if (settings.idle_timeout > 0) {
+		tv.tv_sec = settings.idle_timeout;
+		tv.tv_usec = 0;
+		setsockopt(connfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	}
+}
+
+/**
+ * @brief Wait for a restarted demoserver to open its input lanes again.
+ *
+ * demoserver closes its lanes when it shuts down and the next one
+ * reopens them (with a new epoch, which the lane set follows on the
+ * next send). Meanwhile nothing more is read from the client, so what
+ * it sends stays unacknowledged in the socket buffers.
+ *
+ * @return 0 once the lanes are open, -1 after settings.restart_wait
+ * seconds or if the listener is stopping.
+ */
+static int wait_for_demoserver() {
+	time_t start = time(NULL);
+	struct timespec ts;
+
+	ts.tv_sec = 0;
+	ts.tv_nsec = RESTART_POLL_MSEC * 1000000L;
+	while (msglanes_closed(xmtlanesp)) {
+		if (listener_stop ||
+				((settings.restart_wait > 0) && ((time(NULL) - start) >= settings.restart_wait))) {
+			return -1;
+		}
+		nanosleep(&ts, NULL);
+	}
+	return 0;
+}
+
 /**
  * The command line argument personality function. This simple
  * server has no arguments not already fielded by the socketserver.c
@@ -72,20 +351,91 @@ int pf_register_cmdline(int argc, char* argv[], void* datap) {
 
 /**
  * @brief Initialization personality function. On socket server initialization, we'll attach to the message
- * dequeue of the state machine process.
+ * dequeue of the state machine process, and under ssrvr_start start the thread that reloads settings.
  *
  * @param datap Pointer to custom application data.
  * @return 0 on success.
  */
 int pf_init_server(void* datap) {
-	recmsgcellp = msgdeque_create_byte_stream("demo-socketserver", (S_IRWXU | S_IRWXG), (1024 * 4));
-	xmtmsgcellp = msgdeque_attach("demo-server");
-	if (NULL == xmtmsgcellp) {
+	struct sigaction sa;
+
+	// SA_RESTART: the socket server's own system calls don't need to
+	// know about reloads.
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = demo_sighup;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGHUP, &sa, NULL);
+
+	// Listener processes start concurrently and never read this deque;
+	// recreating it in each one would only race on the deque file.
+	if (!listener_process) {
+		recmsgcellp = msgdeque_create_byte_stream("demo-socketserver", (S_IRWXU | S_IRWXG), (1024 * 4));
+	}
+	xmtlanesp = msglanes_attach(DEMO_SERVER_LANES);
+	if (NULL == xmtlanesp) {
 		ULPPK_CRASH("Unable to attach to demoserver input deque");
 	}
+
+	// Under ssrvr_start, reload in this (the parent) process so the
+	// connection processes inherit current settings. listener_worker
+	// does its own reloading.
+	if (!listener_process) {
+		pthread_t tid;
+		sigset_t hup;
+
+		// Blocked before the thread starts, so it inherits the mask;
+		// connection processes inherit it too and leave reloads to us.
+		sigemptyset(&hup);
+		sigaddset(&hup, SIGHUP);
+		pthread_sigmask(SIG_BLOCK, &hup, NULL);
+		pthread_atfork(reload_prepare_fork, reload_after_fork, reload_after_fork);
+		if (pthread_create(&tid, NULL, reload_thread, NULL)) {
+			ULPPK_LOG(ULPPK_LOG_WARN, "Unable to start settings reload thread ... reloads take a restart");
+		} else {
+			pthread_detach(tid);
+		}
+	}
 	return 0;
 }
 
+/**
+ * @brief Choose the demoserver lane for an encoded event line.
+ *
+ * Control events go on DEMO_LANE_CONTROL, everything else
+ * (including lines without an event) on DEMO_LANE_BULK. Event names
+ * need no URL escaping, so we match the raw "event=" argument
+ * rather than decoding the whole line a second time.
+ *
+ * @param buff URL encoded event line.
+ * @return The lane number.
+ */
+static int select_lane(char* buff) {
+	char* event;
+	size_t evlen;
+	int i;
+
+	for (event = buff; event != NULL; event = strchr(event, '&')) {
+		if (*event == '&') {
+			event++;
+		}
+		if (0 == strncmp(event, "event=", 6)) {
+			break;
+		}
+	}
+	if (NULL == event) {
+		return DEMO_LANE_BULK;
+	}
+	event += 6;
+	evlen = strcspn(event, "&\r\n");
+	for (i = 0; control_events[i] != NULL; i++) {
+		if ((strlen(control_events[i]) == evlen) && (0 == strncmp(event, control_events[i], evlen))) {
+			return DEMO_LANE_CONTROL;
+		}
+	}
+	return DEMO_LANE_BULK;
+}
+
 /**
  * @brief Main personality function for demosocketserver.
  *
@@ -100,30 +450,88 @@ int pf_init_server(void* datap) {
 int pf_demoserver(int connfd, void* datap)  {
 	int retstatus = 0;
 	ssize_t nread;
-	static char buff[1024];
 	LL_HEAD arglist;
 	char* event;
 	char* message;
 	char* serialnumber;
 
+	unsigned long forwarded = 0;
+	unsigned long dropped = 0;
+	int held;
+
 	// TSTRACE("MPF Executes ... CONNECTION ESTABLISHED");
 
-	memset(buff, 0, sizeof(buff));
-	while ((nread = sio_readline(connfd, buff, sizeof(buff))) > 0) {
+	// demoserver is draining for shutdown. Don't read anything until
+	// the next one is up; give up on the connection (nothing read from
+	// it yet) if that takes too long.
+	if (msglanes_closed(xmtlanesp)) {
+		fprintf(stdout, "demoserver is restarting ... waiting before reading\n");
+		fflush(stdout);
+		if (wait_for_demoserver()) {
+			fprintf(stdout, "demoserver did not come back ... connection refused\n");
+			fflush(stdout);
+			return 0;
+		}
+	}
+
+	check_reload();
+	if (size_buffer()) {
+		return 0;
+	}
+	apply_socket_options(connfd);
+
+	memset(buff, 0, buffsize);
+	while ((nread = sio_readline(connfd, buff, buffsize)) > 0) {
 		fprintf(stdout, "LINE: %s\n", buff);
 		fflush(stdout);
 
+		// The kernel drops out of quickack mode on its own; re-arm it.
+		if (settings.tcp_quickack) {
+			int on = 1;
+			setsockopt(connfd, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof(on));
+		}
+
 		// Send the entire encoded request (line of text) to the
-		// message deque server/statemachine
-		if (msgdeque_send_byte_stream(xmtmsgcellp, buff, strlen(buff))) {
-			ULPPK_LOG(ULPPK_LOG_ERROR, "Error sending to demoserver error code: [%d]", xmtmsgcellp->errcode);
+		// message deque server/statemachine, on the lane its event calls for.
+		// If demoserver has closed its input deque for a restart, hold
+		// on to the line and send it to the next one.
+		held = 0;
+		while (msglanes_send_byte_stream(xmtlanesp, select_lane(buff), buff, strlen(buff))) {
+			if (ESHUTDOWN != xmtlanesp->errcode) {
+				ULPPK_LOG(ULPPK_LOG_ERROR, "Error sending to demoserver error code: [%d]", xmtlanesp->errcode);
+				held = -1;
+				break;
+			}
+			if (!held) {
+				fprintf(stdout, "demoserver closed its input deque ... holding the line until it restarts\n");
+				fflush(stdout);
+				held = 1;
+			}
+			if (wait_for_demoserver()) {
+				held = -2;
+				break;
+			}
 		}
+		if (-2 == held) {
+			dropped++;
+			fprintf(stdout, "demoserver did not come back ... closing connection, line not delivered\n");
+			break;
+		} else if (-1 == held) {
+			dropped++;
+		} else {
+			forwarded++;
+		}
+
+		// A resized buffer is picked up by the next connection.
+		check_reload();
+		apply_backpressure();
 	}
 	if (nread == 0) {
 		fprintf(stdout, "EOF Detected\n");
 	} else if (nread < 0 ) {
 		fprintf(stdout, "Read error: errno = %d | %s\n", errno, strerror(errno));
 	}
+	fprintf(stdout, "Connection done: %lu lines forwarded, %lu dropped\n", forwarded, dropped);
 	fflush(stdout);
 	return 0;
 }
@@ -139,6 +547,253 @@ void register_server_pf(SSRVR_HANDLE* ssrvrhp) {
 	ssrvr_register_mpf(ssrvrhp, pf_demoserver);
 }
 
+/**
+ * @brief SIGTERM/SIGINT handler for the listener processes.
+ */
+static void listener_sigstop(int signo) {
+	listener_stop = 1;
+}
+
+/**
+ * @brief Open a non-blocking SO_REUSEPORT listen socket. Each listener
+ * process opens its own, and the kernel spreads incoming connections
+ * across them.
+ *
+ * @return The listen socket, -1 on error.
+ */
+static int open_listener() {
+	int listenfd;
+	int on = 1;
+	struct sockaddr_in addr;
+
+	listenfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (listenfd < 0) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "socket failed: errno = %d | %s", errno, strerror(errno));
+		return -1;
+	}
+	setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if (setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on))) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "SO_REUSEPORT not supported: errno = %d | %s", errno, strerror(errno));
+		close(listenfd);
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(settings.port);
+	if (bind(listenfd, (struct sockaddr*)&addr, sizeof(addr)) || listen(listenfd, settings.backlog)) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "Unable to listen on port %d: errno = %d | %s",
+				settings.port, errno, strerror(errno));
+		close(listenfd);
+		return -1;
+	}
+	return listenfd;
+}
+
+/**
+ * @brief SIGCHLD handler for the listener processes. Nothing to do
+ * here; the signal just wakes poll() so finished connections get reaped.
+ */
+static void listener_sigchld(int signo) {
+}
+
+/**
+ * @brief Serve one accepted connection in a process of its own, the
+ * way the ulppk socketserver does, so a client that sits idle holds up
+ * nobody but itself.
+ *
+ * @param listenfd The listen socket, closed in the connection's process.
+ * @param connfds The accepted connections still open in this listener.
+ * connfds[0] is the one to serve.
+ * @param nconn Number of entries in connfds.
+ */
+static void serve_connection(int listenfd, int* connfds, int nconn) {
+	pid_t pid;
+	int i;
+
+	fflush(stdout);
+	pid = fork();
+	if (pid == 0) {
+		close(listenfd);
+		for (i = 1; i < nconn; i++) {
+			close(connfds[i]);
+		}
+		pf_demoserver(connfds[0], NULL);
+		close(connfds[0]);
+		exit(0);
+	} else if (pid < 0) {
+		ULPPK_LOG(ULPPK_LOG_ERROR, "fork failed: errno = %d | %s ... connection closed",
+				errno, strerror(errno));
+	}
+	close(connfds[0]);
+}
+
+/**
+ * @brief Body of one listener process. Waits for the listen socket to
+ * become readable, then accepts up to accept_batch queued connections
+ * before handing them out, so a connection storm is pulled off the
+ * accept backlog in a few system calls instead of one wakeup per
+ * connection. Each connection is then served by a process of its own.
+ *
+ * @return Exit status for the process.
+ */
+static int listener_worker() {
+	int listenfd;
+	int* connfds;
+	int nconn;
+	int i;
+	struct pollfd pfd;
+	struct sigaction sa;
+
+	listenfd = open_listener();
+	if (listenfd < 0) {
+		return 1;
+	}
+	listener_process = 1;
+	pf_init_server(NULL);
+	connfds = calloc(settings.accept_batch, sizeof(int));
+
+	// No SA_RESTART: a connection that finishes wakes poll() to reap it.
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = listener_sigchld;
+	sa.sa_flags = SA_NOCLDSTOP;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGCHLD, &sa, NULL);
+
+	while (!listener_stop) {
+		while (waitpid(-1, NULL, WNOHANG) > 0) {
+			;
+		}
+		// Reload here rather than in each connection process, so the
+		// ones forked from now on start out with the new settings.
+		i = settings.accept_batch;
+		check_reload();
+		if (i != settings.accept_batch) {
+			free(connfds);
+			connfds = calloc(settings.accept_batch, sizeof(int));
+		}
+		pfd.fd = listenfd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, RELOAD_POLL_MSEC) <= 0) {
+			continue;		// EINTR or timeout: check for stop, reload or finished connections
+		}
+		for (nconn = 0; nconn < settings.accept_batch; nconn++) {
+			connfds[nconn] = accept4(listenfd, NULL, NULL, SOCK_CLOEXEC);
+			if (connfds[nconn] < 0) {
+				if ((EAGAIN != errno) && (EWOULDBLOCK != errno) && (EINTR != errno)) {
+					ULPPK_LOG(ULPPK_LOG_WARN, "accept4 failed: errno = %d | %s", errno, strerror(errno));
+				}
+				break;
+			}
+		}
+		for (i = 0; i < nconn; i++) {
+			serve_connection(listenfd, connfds + i, nconn - i);
+		}
+	}
+	// Connections already being served run on to the end on their own.
+	close(listenfd);
+	free(connfds);
+	return 0;
+}
+
+/**
+ * @brief Run settings.listeners listener processes and keep them running.
+ * A listener that dies is restarted; SIGTERM or SIGINT stops them all.
+ * SIGHUP reloads the settings, starts or stops listeners to match the
+ * new listener count and passes the SIGHUP on to the rest.
+ *
+ * @return 0 on a requested stop.
+ */
+static int run_listeners() {
+	pid_t pids[MAX_LISTENERS];
+	pid_t pid;
+	struct sigaction sa;
+	int i;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = listener_sigstop;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+	sa.sa_handler = demo_sighup;		// no SA_RESTART: wake up wait()
+	sigaction(SIGHUP, &sa, NULL);
+
+	memset(pids, 0, sizeof(pids));
+	while (!listener_stop) {
+		for (i = 0; i < settings.listeners; i++) {
+			if (pids[i] > 0) {
+				continue;
+			}
+			pids[i] = fork();
+			if (pids[i] == 0) {
+				exit(listener_worker());
+			} else if (pids[i] < 0) {
+				ULPPK_LOG(ULPPK_LOG_ERROR, "fork failed: errno = %d | %s", errno, strerror(errno));
+				pids[i] = 0;
+			}
+		}
+		pid = wait(NULL);
+		if (reload_requested) {
+			reload_settings(1);
+			if (settings.listeners < 1) {
+				settings.listeners = 1;		// switching to the ulppk server takes a restart
+			}
+			for (i = 0; i < MAX_LISTENERS; i++) {
+				if (pids[i] <= 0) {
+					continue;
+				}
+				if (i < settings.listeners) {
+					kill(pids[i], SIGHUP);
+				} else {
+					fprintf(stdout, "Stopping listener %d (pid %d)\n", i, (int)pids[i]);
+					kill(pids[i], SIGTERM);
+					pids[i] = 0;
+				}
+			}
+		}
+		for (i = 0; i < settings.listeners; i++) {
+			if ((pid > 0) && (pids[i] == pid)) {
+				if (!listener_stop) {
+					ULPPK_LOG(ULPPK_LOG_WARN, "Listener %d (pid %d) exited ... restarting", i, (int)pid);
+					sleep(1);
+				}
+				pids[i] = 0;
+			}
+		}
+	}
+
+	for (i = 0; i < settings.listeners; i++) {
+		if (pids[i] > 0) {
+			kill(pids[i], SIGTERM);
+		}
+	}
+	while (wait(NULL) > 0) {
+		;
+	}
+	return 0;
+}
+
+/**
+ * @brief Command line handling for listener process mode, where
+ * ssrvr_start is not there to do it.
+ *
+ * @return Non-zero if the program should exit.
+ */
+static int listener_cmdline(int argc, char* argv[]) {
+	char portbuff[16];
+
+	snprintf(portbuff, sizeof(portbuff), "%d", settings.port);
+	cmdarg_init(argc, argv);
+	cmdarg_register_option("h", "help", CA_SWITCH, "Get help on this program", NULL, NULL);
+	cmdarg_register_option("p", "port", CA_DEFAULT_ARG, "Listen port (default from ini file)", portbuff, "h");
+	if (cmdarg_parse(argc, argv) || cmdarg_fetch_switch(NULL, "h")) {
+		cmdarg_show_help(NULL);
+		return 1;
+	}
+	settings.port = cmdarg_fetch_int(NULL, "p");
+	return 0;
+}
+
 int main(int argc, char* argv[]) {
 	int tstate;
 	char* label;
@@ -152,10 +807,21 @@ int main(int argc, char* argv[]) {
 
 	// Parse the INI file
 	sysconfig_parse_inifile("demosocketserver");
+	democonfig_load("demosocketserver");
+	load_settings();
 
 	// Log start of application
 	log_app_start(argc, argv);
 
+	// High fan-in setup: several listener processes sharing the port
+	// via SO_REUSEPORT, each accepting in batches.
+	if (settings.listeners > 0) {
+		if (listener_cmdline(argc, argv)) {
+			return 1;
+		}
+		return run_listeners();
+	}
+
 	// Create a new socket server handle.
 	ssrvrhp = ssrvr_new();
 
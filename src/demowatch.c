@@ -0,0 +1,127 @@
+/*
+ *****************************************************************
+
+<GPL>
+
+Copyright: © 2001-2015 Robert C Garvey
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+ .
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ .
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+X-Comment: On Debian systems, the complete text of the GNU General Public
+ License can be found in `/usr/share/common-licenses/GPL-3'.
+
+</GPL>
+*********************************************************************
+*/
+
+/**
+ * @file demowatch.c
+ *
+ * @brief Follows the demoserver transition broadcast ring and prints
+ * each state change. Also serves as an example subscriber: it only maps
+ * the ring read-only and keeps its own cursor, so any number of these
+ * can run without affecting demoserver.
+ *
+ * Command line arguments and switches:
+ * <ol>
+ * <li>-h --- help</li>
+ * <li>-a --- start with the oldest record still in the ring</li>
+ * <li>-i < msec > poll interval when caught up (default 10)</li>
+ * </ol>
+ */
+/*
+ *  Created on: Oct 19, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cmdargs.h>
+#include <democonfig.h>
+#include <smbcast.h>
+
+/**
+ * @brief Command argument registration/definition
+ *
+ * @return Returns non-zero on error.
+ */
+static int register_cmdline() {
+	int status = 0;
+
+	status |= cmdarg_register_option("h", "help", CA_SWITCH, "Get help on this program", NULL, NULL);
+	status |= cmdarg_register_option("a", "all", CA_SWITCH,
+			"Start with the oldest transition still in the ring", NULL, "h");
+	status |= cmdarg_register_option("i", "interval", CA_DEFAULT_ARG,
+			"Poll interval in msec when caught up (default is 10)", "10", "h");
+	return status;
+}
+
+/**
+ * @brief Main program
+ *
+ */
+int main(int argc, char* argv[]) {
+	SMBCAST* bcastp;
+	SMBCAST_REC rec;
+	int interval;
+	int status;
+	uint64_t lost = 0;
+
+	cmdarg_init(argc, argv);
+	if (register_cmdline()) {
+		fprintf(stderr, "Registration error was reported!\n");
+	}
+	if (cmdarg_parse(argc, argv) || cmdarg_fetch_switch(NULL, "h")) {
+		cmdarg_show_help(NULL);
+		return 1;
+	}
+	interval = cmdarg_fetch_int(NULL, "i");
+
+	bcastp = smbcast_open_reader(DEMO_TRANSITION_BCAST, cmdarg_fetch_switch(NULL, "a"));
+	if (NULL == bcastp) {
+		fprintf(stderr, "Unable to open transition ring %s ... is demoserver running?\n", DEMO_TRANSITION_BCAST);
+		return 1;
+	}
+
+	while (1) {
+		status = smbcast_read(bcastp, &rec);
+		if (status < 0) {
+			// demoserver recreated the ring with another size. Follow
+			// the new ring from its oldest record.
+			fprintf(stdout, "... transition ring recreated, reopening\n");
+			fflush(stdout);
+			smbcast_close(bcastp);
+			while (NULL == (bcastp = smbcast_open_reader(DEMO_TRANSITION_BCAST, 1))) {
+				sleep(1);
+			}
+			lost = 0;
+			continue;
+		}
+		if (0 == status) {
+			usleep(interval * 1000);
+			continue;
+		}
+		if (bcastp->lost != lost) {
+			fprintf(stdout, "... %llu transitions lost (reader fell behind)\n",
+					(unsigned long long)(bcastp->lost - lost));
+			lost = bcastp->lost;
+		}
+		fprintf(stdout, "%lld.%06ld #%llu serial %llu: %s --%s--> %s\n",
+				(long long)rec.tv_sec, (long)(rec.tv_nsec / 1000), (unsigned long long)(rec.seq - 1),
+				(unsigned long long)rec.serialnumber, rec.old_state, rec.event, rec.new_state);
+		fflush(stdout);
+	}
+	return 0;
+}
@@ -0,0 +1,271 @@
+/*
+ *****************************************************************
+
+<GPL>
+
+Copyright: © 2001-2015 Robert C Garvey
+
+ This program is free software; you can redistribute it and/or modify
+ it under the terms of the GNU Lesser General Public License as published by
+ the Free Software Foundation; either version 3 of the License, or
+ (at your option) any later version.
+ .
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ .
+ You should have received a copy of the GNU General Public License along
+ with this program; if not, write to the Free Software Foundation, Inc.,
+ 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+X-Comment: On Debian systems, the complete text of the GNU General Public
+ License can be found in `/usr/share/common-licenses/GPL-3'.
+
+</GPL>
+*********************************************************************
+*/
+
+/**
+ * @file evarchtest.c
+ *
+ * @brief Round trip checks for the event archive (see evarchive.h), run
+ * by "make check": the LZ compressor on its own, then events appended
+ * to an archive and read back column by column.
+ */
+/*
+ *  Created on: Oct 19, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <evarchive.h>
+
+#define LZ_MAX 65536			// largest buffer put through the compressor
+#define LZ_GUARD 64				// bytes past the output buffer that must stay untouched
+#define ARCH_EVENTS ((EVARCH_BLOCK_EVENTS * 2) + 1234)	// three blocks, the last one partial
+
+static int failures = 0;
+
+static void check(int ok, char* what, long n) {
+	if (!ok) {
+		fprintf(stderr, "FAIL: %s (%ld)\n", what, n);
+		failures++;
+	}
+}
+
+/*
+ * Compress one buffer into no more than its own length, inflate it, then
+ * compress it again into exactly the room it needs and into one byte
+ * less. Data that doesn't compress (must_fit 0) may be refused, as long
+ * as nothing is written past the output buffer.
+ */
+static void lz_round_trip(unsigned char* src, size_t len, int must_fit) {
+	static unsigned char packed[LZ_MAX + LZ_GUARD];
+	static unsigned char unpacked[LZ_MAX];
+	size_t stored;
+	size_t i;
+
+	memset(packed, 0xa5, sizeof(packed));
+	stored = evarch_lz_compress(src, len, packed, len);
+	if (0 == stored) {
+		check(!must_fit, "compress", (long)len);
+		for (i = len; i < len + LZ_GUARD; i++) {
+			check(0xa5 == packed[i], "refused compress wrote past its buffer", (long)len);
+		}
+		return;
+	}
+	check(evarch_lz_decompress(packed, stored, unpacked, len) == (ssize_t)len, "inflated length", (long)len);
+	check(0 == memcmp(src, unpacked, len), "inflated data", (long)len);
+	if (len > 0) {
+		check(evarch_lz_decompress(packed, stored, unpacked, len - 1) < 0, "inflate into too small a buffer", (long)len);
+	}
+
+	memset(packed, 0xa5, sizeof(packed));
+	check(evarch_lz_compress(src, len, packed, stored) == stored, "compress into an exact fit", (long)len);
+	check(evarch_lz_decompress(packed, stored, unpacked, len) == (ssize_t)len, "exact fit inflated length", (long)len);
+	for (i = stored; i < stored + LZ_GUARD; i++) {
+		check(0xa5 == packed[i], "exact fit wrote past its buffer", (long)len);
+	}
+
+	memset(packed, 0xa5, sizeof(packed));
+	check(0 == evarch_lz_compress(src, len, packed, stored - 1), "compress into one byte too few", (long)len);
+	for (i = stored - 1; i < stored - 1 + LZ_GUARD; i++) {
+		check(0xa5 == packed[i], "short buffer written past its end", (long)len);
+	}
+}
+
+static void lz_checks() {
+	static unsigned char src[LZ_MAX];
+	size_t sizes[] = { 0, 1, 4, 5, 12, 13, 100, 4096, LZ_MAX };
+	size_t n;
+	size_t i;
+
+	srand(1);
+	for (n = 0; n < sizeof(sizes) / sizeof(sizes[0]); n++) {
+		// Runs of one byte
+		memset(src, 'x', sizes[n]);
+		lz_round_trip(src, sizes[n], sizes[n] > 16);
+
+		// Short repeating pattern with the odd change, like a name column
+		for (i = 0; i < sizes[n]; i++) {
+			src[i] = (i % 7) + ((0 == rand() % 50) ? 100 : 0);
+		}
+		lz_round_trip(src, sizes[n], sizes[n] > 1024);
+
+		// Noise: may not compress at all, but must never overrun
+		for (i = 0; i < sizes[n]; i++) {
+			src[i] = rand();
+		}
+		lz_round_trip(src, sizes[n], 0);
+	}
+}
+
+/*
+ * Append ARCH_EVENTS events, then read every column of every block
+ * back and compare.
+ */
+static void archive_checks() {
+	char* states[] = { "DEMO_STATE1", "DEMO_STATE2", "DEMO_STATE3" };
+	char* events[] = { "DEMO_EVENT1", "DEMO_EVENT2", "DEMO_EVENT3", "DEMO_EVENT4" };
+	char dir[] = "/tmp/evarchtest-XXXXXX";
+	char cmd[64];
+	int64_t* ts = malloc(ARCH_EVENTS * sizeof(int64_t));
+	uint64_t* serial = malloc(ARCH_EVENTS * sizeof(uint64_t));
+	uint8_t* codes[EVARCH_NCOLS];
+	int64_t values[EVARCH_BLOCK_EVENTS];
+	uint8_t names[EVARCH_BLOCK_EVENTS];
+	EVARCH* archp;
+	EVARCH_READER* readerp;
+	EVARCH_BLOCKHDR* blockp;
+	uint32_t blockno;
+	long base = 0;
+	long i;
+	int col;
+	int n;
+
+	if (NULL == mkdtemp(dir)) {
+		check(0, "make archive directory", 0);
+		return;
+	}
+	for (col = EVARCH_COL_OLD; col < EVARCH_NCOLS; col++) {
+		codes[col] = malloc(ARCH_EVENTS);
+	}
+
+	archp = evarch_open(dir, "check", 0600);
+	check(NULL != archp, "open archive writer", 0);
+	if (NULL == archp) {
+		return;
+	}
+	srand(2);
+	for (i = 0; i < ARCH_EVENTS; i++) {
+		ts[i] = 1790000000000000000LL + (i * 1000003LL) + (rand() % 1000);
+		serial[i] = (0 == rand() % 20) ? 0 : (uint64_t)i * 3;		// some events have no serial number
+		codes[EVARCH_COL_OLD][i] = rand() % 3;
+		codes[EVARCH_COL_NEW][i] = rand() % 3;
+		codes[EVARCH_COL_EVENT][i] = rand() % 4;
+		check(0 == evarch_append(archp, ts[i], states[codes[EVARCH_COL_OLD][i]], states[codes[EVARCH_COL_NEW][i]],
+				events[codes[EVARCH_COL_EVENT][i]], serial[i]), "append", i);
+	}
+	evarch_close(archp);
+
+	readerp = evarch_open_reader(dir, "check");
+	check(NULL != readerp, "open archive reader", 0);
+	if (NULL == readerp) {
+		return;
+	}
+	check(3 == readerp->nblocks, "block count", readerp->nblocks);
+	for (blockno = 0; blockno < readerp->nblocks; blockno++) {
+		blockp = evarch_block(readerp, blockno);
+		check(NULL != blockp, "block header", blockno);
+		if (NULL == blockp) {
+			continue;
+		}
+		check(0 == ((uintptr_t)blockp % EVARCH_BLOCK_ALIGN), "block alignment", blockno);
+
+		n = evarch_read_column(readerp, blockno, EVARCH_COL_TIME, values);
+		check(n == (int)blockp->count, "time column count", blockno);
+		for (i = 0; i < n; i++) {
+			check(values[i] == ts[base + i], "time", base + i);
+		}
+		n = evarch_read_column(readerp, blockno, EVARCH_COL_SERIAL, values);
+		check(n == (int)blockp->count, "serial number column count", blockno);
+		for (i = 0; i < n; i++) {
+			check((uint64_t)values[i] == serial[base + i], "serial number", base + i);
+		}
+		for (col = EVARCH_COL_OLD; col < EVARCH_NCOLS; col++) {
+			n = evarch_read_column(readerp, blockno, col, names);
+			check(n == (int)blockp->count, "name column count", blockno);
+			for (i = 0; i < n; i++) {
+				check(0 == strcmp(evarch_dict_name(blockp, names[i]),
+						(EVARCH_COL_EVENT == col) ? events[codes[col][base + i]] : states[codes[col][base + i]]),
+						"name", base + i);
+			}
+		}
+		base += blockp->count;
+	}
+	check(ARCH_EVENTS == base, "events read back", base);
+	evarch_close_reader(readerp);
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+	system(cmd);
+	for (col = EVARCH_COL_OLD; col < EVARCH_NCOLS; col++) {
+		free(codes[col]);
+	}
+	free(serial);
+	free(ts);
+}
+
+/*
+ * A partial block is written by evarch_flush_if_due once its first
+ * event is flush_secs old, and not before.
+ */
+static void idle_flush_checks() {
+	char dir[] = "/tmp/evarchtest-XXXXXX";
+	char cmd[64];
+	int64_t ts = 1790000000000000000LL;
+	EVARCH* archp;
+	EVARCH_READER* readerp;
+
+	if (NULL == mkdtemp(dir)) {
+		check(0, "make archive directory", 0);
+		return;
+	}
+	archp = evarch_open(dir, "idle", 0600);
+	check(NULL != archp, "open archive writer", 0);
+	if (NULL == archp) {
+		return;
+	}
+	archp->flush_secs = 10;
+	evarch_append(archp, ts, "DEMO_STATE1", "DEMO_STATE2", "DEMO_EVENT1", 1);
+	check(0 == evarch_flush_if_due(archp, ts + 9000000000LL), "flush not yet due", 0);
+	check(1 == archp->count, "block kept before flush_secs", archp->count);
+	check(0 == evarch_flush_if_due(archp, ts + 10000000000LL), "flush due", 0);
+	check(0 == archp->count, "block written at flush_secs", archp->count);
+
+	readerp = evarch_open_reader(dir, "idle");
+	check(NULL != readerp, "open archive reader", 0);
+	if (NULL != readerp) {
+		check(1 == readerp->nblocks, "idle flush block count", readerp->nblocks);
+		evarch_close_reader(readerp);
+	}
+	evarch_close(archp);
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+	system(cmd);
+}
+
+int main(int argc, char* argv[]) {
+	lz_checks();
+	archive_checks();
+	idle_flush_checks();
+	if (failures > 0) {
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	fprintf(stdout, "evarchive checks passed\n");
+	return 0;
+}
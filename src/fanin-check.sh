@@ -0,0 +1,51 @@
+#!/bin/bash
+#
+# Check that idle clients can't hold up demosocketserver's listener
+# processes. Opens more idle connections than there are listeners,
+# sends one event over a fresh connection and waits for demoserver to
+# take the transition it causes.
+#
+# demoserver and demosocketserver (listeners > 0) must be running.
+#
+# Usage: fanin-check.sh [listeners] [port] [bindir]
+
+listeners=${1:-4}
+port=${2:-49152}
+bindir=${3:-.}
+idle=$((listeners * 4))
+watchlog=$(mktemp)
+
+echo "Opening $idle idle connections to port $port ($listeners listeners)"
+for ((i = 0; i < idle; i++)); do
+	exec {fd}<>/dev/tcp/localhost/$port || exit 1
+	fds+=($fd)
+done
+
+"$bindir"/demowatch > "$watchlog" &
+watchpid=$!
+sleep 1
+
+# DEMO_EVENT1 leads out of every running state.
+"$bindir"/demosocketclient -p $port -e DEMO_EVENT1 -m "eventmessage=fanin-check" > /dev/null
+
+status=1
+for ((i = 0; i < 50; i++)); do
+	if grep -q -- "--DEMO_EVENT1-->" "$watchlog"; then
+		status=0
+		break
+	fi
+	sleep 0.1
+done
+
+kill $watchpid
+for fd in "${fds[@]}"; do
+	exec {fd}>&-
+done
+rm -f "$watchlog"
+
+if [ $status -eq 0 ]; then
+	echo "PASS: event served with $idle idle connections open"
+else
+	echo "FAIL: event not served within 5 seconds with $idle idle connections open"
+fi
+exit $status